@@ -88,8 +88,9 @@ local function check_proto(opcodes, proto)
         end
     end
 
-    for i, k in ipairs(proto:instructions()) do
-        check_instruction(i, k)
+    local instructions = proto:instructions()
+    for i = 1, #instructions do
+        check_instruction(i, instructions[i])
     end
     return result
 end
@@ -150,11 +151,10 @@ function on_open_file(file)
                  or nil
 
     message('finding invalid opcodes...')
-    for i, k in ipairs(info:protos()) do
-        local result = find_instructions(file, i, check_proto(opcodes, k))
-        for l, p in ipairs(result) do
-            highlight(p[1], p[2], 0xFFFF00)
-        end
+    local protos = info:protos()
+    for i = 1, #protos do
+        local result = find_instructions(file, i, check_proto(opcodes, protos[i]))
+        highlight_many(result, 0xFFFF00)
         count = count + #result
     end
 
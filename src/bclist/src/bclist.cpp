@@ -15,8 +15,15 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <bit>
 #include <numeric>
+#include <cstring>
+#include <type_traits>
 #include <algorithm>
+#include <exception>
 #include <functional>
 
 #include <fmt/core.h>
@@ -24,87 +31,13 @@
 #include "bclist.hpp"
 #include "bclist/lj.hpp"
 
-std::vector<std::string> split(const std::string &str, const char *delim) {
-    std::vector<std::string> res;
-    size_t                   prev_pos = 0, pos = 0;
-    while ((pos = str.find(delim, pos)) != std::string::npos) {
-        res.emplace_back(str.substr(prev_pos, pos - prev_pos));
-        prev_pos = ++pos;
-    }
-
-    res.emplace_back(str.substr(prev_pos, pos - prev_pos));
-    return res;
-}
-
-std::string bclist::div::string(bool from) const {
-    const bclist::div &onl = only_lines();
-    if (onl.lines.empty())
-        return "";
-
-    //  too slow
-    //  std::string res = std::accumulate(
-    //      onl.lines.begin(), onl.lines.end(), std::string{},
-    //      [](const std::string &v, const bclist::div::line &l) {return v + fmt::format("{:08X}: {}\n", l.from, l); });
-
-    std::string res;
-    for (const bclist::div::line &l: onl.lines) {
-        if (from) {
-            res += fmt::format("{:08X}: {}\n", l.from, l.text);
-        } else {
-            res += l.text + '\n';
-        }
-    }
-    res.pop_back(); // remove last \n
-    return res;
-}
-
-bclist::div bclist::div::only_lines() const {
-    const bool already_done = header.empty() && footer.empty() && additional.empty() && tab == 0;
-    if (already_done) {
-        return *this;
-    }
-
-    const std::size_t st = start(), en = end();
-    const std::string prev_tab(std::max(tab, std::size_t{1}) - 1, '\t'), cur_tab(tab, '\t');
-
-    std::vector<bclist::div::line> res;
-    res.reserve(lines.size() + additional.size() * 10);
-    static const auto add_line = [](std::vector<bclist::div::line> &ls, const bclist::div::line &l, const std::string &t) {
-        for (std::string &line: split(l.text, "\n")) {
-            line.insert(0, t);
-            ls.emplace_back(std::move(line), l.from, l.to, l.key);
-        }
-    };
-
-    if (!header.empty()) {
-        add_line(res, bclist::div::line{header, st, st, key}, prev_tab);
-    }
-    for (const bclist::div::line &line: lines) {
-        add_line(res, line, cur_tab);
-    }
-    for (const div &add: additional) {
-        const bclist::div &&onl = add.only_lines();
-        res.reserve(res.size() + onl.lines.size());
-        for (const bclist::div::line &line: onl.lines) {
-            add_line(res, line, cur_tab);
-        }
-    }
-    if (!footer.empty()) {
-        add_line(res, bclist::div::line{footer, en, en}, prev_tab);
-    }
-
-    bclist::div new_div{};
-    new_div.lines = std::move(res);
-    return new_div;
-}
-
 bool bclist::div::empty() const {
     if (!header.empty() || !footer.empty()) {
         return false;
     }
 
     if (!lines.empty() && !std::all_of(lines.begin(), lines.end(), [](const line &v) {
-            return v.text.empty();
+            return v.text.empty() && v.lazy.type == deferred::none;
         })) {
         return false;
     }
@@ -136,6 +69,157 @@ size_t bclist::div::end() const {
     return max_line;
 }
 
+std::string_view bclist::line_table::text(size_t i) const {
+    return std::string_view{arena}.substr(text_begin[i], text_begin[i + 1] - text_begin[i]);
+}
+
+std::span<const bclist::token> bclist::line_table::tokens_of(size_t i) const {
+    return std::span{tokens}.subspan(token_begin[i], token_begin[i + 1] - token_begin[i]);
+}
+
+size_t bclist::line_table::line(symbol key) const {
+    const auto id = static_cast<size_t>(key);
+    if (key == symbol::none || id >= key_lines.size())
+        return max_line;
+    return key_lines[id];
+}
+
+void bclist::line_table::clear() {
+    from.clear();
+    to.clear();
+    keys.clear();
+    indent.clear();
+    text_begin.assign(1, 0);
+    arena.clear();
+    key_lines.clear();
+    lazy.clear();
+    token_begin.assign(1, 0);
+    tokens.clear();
+    reach.clear();
+    max_to.clear();
+}
+// rows, text bytes and tokens (at most) that the div adds to a line table
+void count_lines(const bclist::div &d, size_t &rows, size_t &bytes, size_t &tokens) {
+    const auto text = [&](std::string_view str, size_t toks) {
+        const auto breaks = static_cast<size_t>(std::count(str.begin(), str.end(), '\n'));
+        rows += 1 + breaks;
+        bytes += str.size();
+        tokens += toks * (1 + breaks); // a token may be split at each line break
+    };
+    if (!d.header.empty())
+        text(d.header, 0);
+    if (!d.footer.empty())
+        text(d.footer, 0);
+    for (const auto &l: d.lines)
+        text(l.text, l.tokens.size());
+    for (const auto &add: d.additional)
+        count_lines(add, rows, bytes, tokens);
+}
+
+void bclist::line_table::add(div &d) {
+    size_t rows = size(), bytes = arena.size(), toks = tokens.size();
+    count_lines(d, rows, bytes, toks);
+    for (auto *v: {&from, &to, &text_begin, &token_begin})
+        v->reserve(rows + 1);
+    keys.reserve(rows);
+    indent.reserve(rows);
+    lazy.reserve(rows);
+    arena.reserve(bytes);
+    tokens.reserve(toks);
+
+    add(d, 0);
+    build_index();
+}
+
+void bclist::line_table::add(div &d, size_t tab) {
+    const size_t st = d.start(), en = d.end();
+    const size_t prev_tab = tab + std::max(d.tab, size_t{1}) - 1, cur_tab = tab + d.tab;
+
+    if (!d.header.empty())
+        add_line(d.header, st, st, d.key, prev_tab);
+    for (div::line &l: d.lines) {
+        l.row = size();
+        add_line(l.text, l.from, l.to, l.key, cur_tab, l.lazy, l.tokens);
+        l.rows = size() - l.row;
+        // the text is kept once, in the arena
+        std::string{}.swap(l.text);
+        std::vector<token>{}.swap(l.tokens);
+    }
+    for (div &add: d.additional)
+        this->add(add, cur_tab);
+    if (!d.footer.empty())
+        add_line(d.footer, en, en, symbol::none, prev_tab);
+}
+
+void bclist::line_table::add_line(std::string_view text, size_t f, size_t t, symbol key, size_t tab, deferred d, std::span<const token> toks) {
+    if (key != symbol::none) {
+        const auto id = static_cast<size_t>(key);
+        if (id >= key_lines.size())
+            key_lines.resize(id + 1, max_line);
+        if (key_lines[id] == max_line)
+            key_lines[id] = size();
+    }
+
+    // one entry for each line of the text, tokens crossing a line break are split
+    size_t pos = 0;
+    while (true) {
+        const size_t next = text.find('\n', pos);
+        const size_t end  = next == std::string_view::npos ? text.size() : next;
+        arena += text.substr(pos, end - pos);
+        text_begin.push_back(arena.size());
+
+        for (const token &tk: toks) {
+            const size_t first = std::max<size_t>(tk.offset, pos), last = std::min<size_t>(tk.offset + tk.length, end);
+            if (first < last)
+                tokens.push_back({static_cast<std::uint32_t>(first - pos), static_cast<std::uint32_t>(last - first), tk.type, tk.key});
+        }
+        token_begin.push_back(tokens.size());
+
+        from.push_back(f);
+        to.push_back(t);
+        keys.push_back(key);
+        indent.push_back(static_cast<std::uint32_t>(tab));
+        lazy.push_back(d);
+
+        if (next == std::string_view::npos)
+            break;
+        pos = next + 1;
+    }
+}
+
+bclist::symbol bclist::symbol_table::intern(std::string_view name) {
+    if (const symbol id = find(name); id != symbol::none || name.empty())
+        return id;
+
+    const auto id = static_cast<symbol>(size());
+    pool += name;
+    begin.push_back(pool.size());
+    index.emplace(std::hash<std::string_view>{}(name), id);
+    return id;
+}
+
+void bclist::symbol_table::clear() {
+    pool.clear();
+    begin.assign(2, 0); // symbol::none is an empty name
+    index.clear();
+}
+
+bclist::symbol bclist::symbol_table::find(std::string_view name) const {
+    const auto [first, last] = index.equal_range(std::hash<std::string_view>{}(name));
+    for (auto it = first; it != last; ++it) {
+        if (this->name(it->second) == name)
+            return it->second;
+    }
+    return symbol::none;
+}
+
+std::string_view bclist::symbol_table::name(symbol id) const {
+    const auto i = static_cast<size_t>(id);
+    if (i >= size())
+        return {};
+    return std::string_view{pool}.substr(begin[i], begin[i + 1] - begin[i]);
+}
+
 void bclist::div::empty_line(size_t p) {
     if (p == bclist::max_line && !lines.empty())
         p = lines.back().from;
@@ -147,24 +231,800 @@ void bclist::div::add_div(const bclist::div &d) {
         additional.push_back(d);
 }
 
-void bclist::add_ref(std::size_t key, std::size_t value) {
-    auto it = refs.find(key);
-    if (it == refs.end()) {
-        refs.emplace(key, std::vector<std::size_t>{value});
-    } else {
-        it->second.push_back(value);
+void bclist::div::add_div(bclist::div &&d) {
+    if (!d.empty())
+        additional.push_back(std::move(d));
+}
+
+bool bclist::flow::is_target(size_t ins) const {
+    return ins < targets.size() && targets[ins];
+}
+
+size_t bclist::flow::block_at(size_t ins) const {
+    if (ins >= block_of.size())
+        return max_line;
+    return block_of[ins];
+}
+
+std::span<const size_t> bclist::flow::jumps_to(size_t ins) const {
+    if (ins + 1 >= jump_index.size())
+        return {};
+    return std::span{jump_from}.subspan(jump_index[ins], jump_index[ins + 1] - jump_index[ins]);
+}
+
+// the last line of [lo, hi) before end with to >= addr, the node covers [lo, hi)
+size_t last_line(const std::vector<size_t> &tree, size_t node, size_t lo, size_t hi, size_t end, size_t addr) {
+    if (lo >= end || tree[node] < addr)
+        return bclist::max_line;
+    if (hi - lo == 1)
+        return lo;
+
+    const size_t mid = lo + (hi - lo) / 2;
+    const size_t res = last_line(tree, 2 * node + 1, mid, hi, end, addr);
+    return res != bclist::max_line ? res : last_line(tree, 2 * node, lo, mid, end, addr);
+}
+
+void bclist::line_table::build_index() {
+    reach.resize(size());
+    size_t max = 0;
+    for (size_t i = 0; i < size(); i++) {
+        max      = std::max(max, to[i]);
+        reach[i] = max;
+    }
+
+    const size_t leaves = std::bit_ceil(std::max(size(), size_t{1}));
+    max_to.assign(2 * leaves, 0);
+    std::copy(to.begin(), to.end(), max_to.begin() + static_cast<std::ptrdiff_t>(leaves));
+    for (size_t i = leaves - 1; i > 0; i--) {
+        max_to[i] = std::max(max_to[2 * i], max_to[2 * i + 1]);
     }
 }
 
-void bclist::add_ref(std::size_t key, const std::vector<std::size_t> &values) {
-    auto it = refs.find(key);
-    if (it == refs.end()) {
-        refs.emplace(key, values);
+std::pair<size_t, size_t> bclist::line_table::lines_at(size_t addr) const {
+    constexpr std::pair none{max_line, max_line};
+    if (empty() || reach.size() != size())
+        return none;
+
+    // lines [0, end) start at or before addr
+    const size_t end = static_cast<size_t>(std::upper_bound(from.begin(), from.end(), addr) - from.begin());
+    // the first line with to >= addr, `reach` is sorted
+    const size_t first = static_cast<size_t>(std::lower_bound(reach.begin(), reach.end(), addr) - reach.begin());
+    if (first >= end)
+        return none;
+
+    const size_t last = last_line(max_to, 1, 0, max_to.size() / 2, end, addr);
+    return {first, last == max_line ? first : last};
+}
+
+size_t bclist::line_table::line_at(size_t addr, bool last) const {
+    const auto [first, second] = lines_at(addr);
+    return last ? second : first;
+}
+
+std::pair<size_t, size_t> bclist::line_table::span(size_t i) const {
+    if (i >= size())
+        return {max_line, max_line};
+    return {from[i], to[i]};
+}
+
+void bclist::append_line(std::string &out, size_t i, bool with_from) const {
+    if (with_from)
+        fmt::format_to(std::back_inserter(out), "{:08X}: ", lines.from[i]);
+    out.append(lines.indent[i], '\t');
+    if (lines.lazy[i].type == deferred::none)
+        out += lines.text(i);
+    else
+        out += materialize(lines.lazy[i], nullptr);
+}
+
+std::string bclist::full(bool with_from) const {
+    std::string res;
+    res.reserve(lines.arena.size() + lines.size() * (with_from ? 12 : 2));
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (i != 0)
+            res += '\n';
+        append_line(res, i, with_from);
+    }
+    return res;
+}
+
+namespace {
+constexpr size_t write_chunk_size = 64 * 1024;
+
+// length of the valid UTF-8 sequence at the start of str, 0 if it isn't valid
+size_t utf8_length(std::string_view str) {
+    const auto byte = [&](size_t i) {
+        return static_cast<unsigned char>(str[i]);
+    };
+    const unsigned char c = byte(0);
+    size_t              len;
+    char32_t            cp;
+    if (c < 0x80)
+        return 1;
+    if ((c & 0xE0) == 0xC0) {
+        len = 2;
+        cp  = c & 0x1F;
+    } else if ((c & 0xF0) == 0xE0) {
+        len = 3;
+        cp  = c & 0x0F;
+    } else if ((c & 0xF8) == 0xF0) {
+        len = 4;
+        cp  = c & 0x07;
     } else {
-        for (const auto &v: values) {
-            it->second.push_back(v);
+        return 0;
+    }
+    if (str.size() < len)
+        return 0;
+    for (size_t i = 1; i < len; i++) {
+        if ((byte(i) & 0xC0) != 0x80)
+            return 0;
+        cp = (cp << 6) | (byte(i) & 0x3F);
+    }
+    // overlong forms, surrogates and values past U+10FFFF
+    constexpr char32_t min[] = {0, 0, 0x80, 0x800, 0x10000};
+    if (cp < min[len] || (cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF)
+        return 0;
+    return len;
+}
+} // namespace
+
+bool bclist::write_chunk(std::FILE *out, std::string &buf, bool all) {
+    if (!all && buf.size() < write_chunk_size)
+        return true;
+    const bool res = std::fwrite(buf.data(), 1, buf.size(), out) == buf.size();
+    buf.clear();
+    return res && (!all || std::fflush(out) == 0);
+}
+
+bool bclist::write(std::FILE *out, bool with_from) const {
+    std::string buf;
+    buf.reserve(write_chunk_size + 256);
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (i != 0)
+            buf += '\n';
+        append_line(buf, i, with_from);
+        if (!write_chunk(out, buf))
+            return false;
+    }
+    return write_chunk(out, buf, true);
+}
+
+void bclist::json_string(std::string &out, std::string_view str) {
+    out += '"';
+    for (size_t i = 0; i < str.size();) {
+        const char c = str[i];
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (const size_t len = utf8_length(str.substr(i)); len != 0 && static_cast<unsigned char>(c) >= 0x20) {
+                out += str.substr(i, len);
+                i += len;
+                continue;
+            }
+            fmt::format_to(std::back_inserter(out), "\\u{:04X}", static_cast<unsigned char>(c));
+            break;
+        }
+        i++;
+    }
+    out += '"';
+}
+
+bool bclist::write_json(std::FILE *out) {
+    std::string buf;
+    buf.reserve(write_chunk_size + 256);
+    for (size_t i = 0; i < lines.size(); i++) {
+        fmt::format_to(std::back_inserter(buf), "{{\"from\":{},\"to\":{}", lines.from[i], lines.to[i]);
+        if (lines.keys[i] != symbol::none) {
+            buf += ",\"key\":";
+            json_string(buf, symbols.name(lines.keys[i]));
+        }
+        buf += ",\"text\":";
+        json_string(buf, lines.lazy[i].type == deferred::none ? std::string{lines.text(i)} : materialize(lines.lazy[i], nullptr));
+        buf += "}\n";
+        if (!write_chunk(out, buf))
+            return false;
+    }
+    return write_chunk(out, buf, true);
+}
+
+template <typename F>
+auto bclist::cached(size_t row, F &&fn) const {
+    {
+        std::lock_guard lock{cache.mutex};
+        if (const auto it = cache.rows.find(row); it != cache.rows.end()) {
+            cache.order.splice(cache.order.begin(), cache.order, it->second);
+            return fn(*it->second);
+        }
+    }
+
+    text_cache::entry res{row, {}, {}};
+    res.text = materialize(lines.lazy[row], &res.tokens);
+    if (option.cache_size == 0)
+        return fn(res);
+
+    std::lock_guard lock{cache.mutex};
+    if (cache.rows.contains(row)) // added by another thread
+        return fn(res);
+    cache.order.push_front(std::move(res));
+    cache.rows.emplace(row, cache.order.begin());
+    auto result = fn(cache.order.front());
+    while (cache.order.size() > option.cache_size) {
+        cache.rows.erase(cache.order.back().row);
+        cache.order.pop_back();
+    }
+    return result;
+}
+
+std::string bclist::text(size_t row) const {
+    if (row >= lines.size())
+        return {};
+    if (lines.lazy[row].type == deferred::none)
+        return std::string{lines.text(row)};
+    return cached(row, [](const text_cache::entry &e) {
+        return e.text;
+    });
+}
+
+std::vector<bclist::token> bclist::tokens(size_t row) const {
+    if (row >= lines.size())
+        return {};
+    if (lines.lazy[row].type == deferred::none) {
+        const auto res = lines.tokens_of(row);
+        return {res.begin(), res.end()};
+    }
+    return cached(row, [](const text_cache::entry &e) {
+        return e.tokens;
+    });
+}
+
+std::string bclist::text(const div::line &l) const {
+    if (l.row == max_line) // not in the line table
+        return l.lazy.type == deferred::none ? l.text : materialize(l.lazy, nullptr);
+
+    std::string res;
+    for (size_t i = l.row; i < l.row + l.rows; i++) {
+        if (i != l.row)
+            res += '\n';
+        res += text(i);
+    }
+    return res;
+}
+
+template <typename F>
+void bclist::each_line(const div &d, size_t tab, F &&fn) const {
+    const auto split = [&fn](std::string_view text, size_t f, size_t t, symbol key, size_t line_tab) {
+        for (size_t pos = 0;;) {
+            const size_t next = text.find('\n', pos);
+            fn(text.substr(pos, next == std::string_view::npos ? std::string_view::npos : next - pos), f, t, key, line_tab);
+            if (next == std::string_view::npos)
+                break;
+            pos = next + 1;
         }
+    };
+
+    const size_t st = d.start(), en = d.end();
+    const size_t prev_tab = tab + std::max(d.tab, size_t{1}) - 1, cur_tab = tab + d.tab;
+    if (!d.header.empty())
+        split(d.header, st, st, d.key, prev_tab);
+    for (const div::line &l: d.lines)
+        split(text(l), l.from, l.to, l.key, cur_tab);
+    for (const div &add: d.additional)
+        each_line(add, cur_tab, fn);
+    if (!d.footer.empty())
+        split(d.footer, en, en, symbol::none, prev_tab);
+}
+
+std::string bclist::string(const div &d, bool with_from) const {
+    std::string res;
+    each_line(d, 0, [&](std::string_view text, size_t f, size_t, symbol, size_t tab) {
+        if (with_from)
+            fmt::format_to(std::back_inserter(res), "{:08X}: ", f);
+        res.append(tab, '\t');
+        res += text;
+        res += '\n';
+    });
+    if (!res.empty())
+        res.pop_back(); // remove last \n
+    return res;
+}
+
+bclist::div bclist::only_lines(const div &d) const {
+    div res{};
+    each_line(d, 0, [&](std::string_view text, size_t f, size_t t, symbol key, size_t tab) {
+        std::string str(tab, '\t');
+        str += text;
+        res.lines.emplace_back(str, f, t, key);
+    });
+    return res;
+}
+
+bool bclist::empty(const div &d) const {
+    if (!d.header.empty() || !d.footer.empty())
+        return false;
+    for (const div::line &l: d.lines) {
+        if (l.lazy.type != deferred::none || !text(l).empty())
+            return false;
+    }
+    return std::all_of(d.additional.begin(), d.additional.end(), [this](const div &add) {
+        return empty(add);
+    });
+}
+
+void bclist::clear_cache() {
+    std::lock_guard lock{cache.mutex};
+    cache.order.clear();
+    cache.rows.clear();
+}
+
+void bclist::clear() {
+    divs = {};
+    xrefs.clear();
+    flows.clear();
+    lines.clear();
+    symbols.clear();
+    clear_cache();
+    offset = 0;
+}
+
+void bclist::parallel_for(size_t count, const std::function<void(size_t)> &fn) const {
+    size_t threads = option.threads;
+    if (threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    threads = std::min(threads, count);
+
+    if (threads <= 1) {
+        for (size_t i = 0; i < count; i++)
+            fn(i);
+        return;
+    }
+
+    std::atomic_size_t next = 0;
+    std::exception_ptr error;
+    std::mutex         error_mutex;
+    const auto         worker = [&] {
+        for (size_t i; (i = next++) < count;) {
+            try {
+                fn(i);
+            } catch (...) {
+                const std::lock_guard lock{error_mutex};
+                if (!error)
+                    error = std::current_exception();
+                next = count;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (size_t i = 1; i < threads; i++)
+        pool.emplace_back(worker);
+    worker();
+    for (std::thread &t: pool)
+        t.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+std::span<const bclist::xref_table::use> bclist::xref_table::find(size_t def) const {
+    const auto it = std::lower_bound(defs.begin(), defs.end(), def);
+    if (it == defs.end() || *it != def)
+        return {};
+    return at(static_cast<size_t>(it - defs.begin()));
+}
+
+std::span<const bclist::xref_table::use> bclist::xref_table::at(size_t i) const {
+    if (i >= defs.size())
+        return {};
+    return std::span{uses}.subspan(index[i], index[i + 1] - index[i]);
+}
+
+void bclist::xref_table::clear() {
+    defs.clear();
+    index.clear();
+    uses.clear();
+}
+
+void bclist::xref_table::build(std::vector<std::pair<size_t, use>> &&refs, const line_table &lines) {
+    clear();
+    std::stable_sort(refs.begin(), refs.end(), [](const auto &a, const auto &b) {
+        return a.first < b.first;
+    });
+
+    uses.reserve(refs.size());
+    for (auto &[def, u]: refs) {
+        if (defs.empty() || defs.back() != def) {
+            defs.push_back(def);
+            index.push_back(uses.size());
+        }
+        u.line = lines.line_at(u.addr, true);
+        uses.push_back(u);
+    }
+    index.push_back(uses.size());
+}
+
+// serialized data uses the native byte order and sizes, it's not portable between machines
+struct blob_writer {
+    std::string out;
+
+    void u64(std::uint64_t v) {
+        raw(&v, sizeof(v));
+    }
+    void str(std::string_view v) {
+        u64(v.size());
+        out += v;
+    }
+    template <typename T>
+    void vec(const std::vector<T> &v) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        u64(v.size());
+        raw(v.data(), v.size() * sizeof(T));
+    }
+    void raw(const void *data, size_t size) {
+        out.append(static_cast<const char *>(data), size);
+    }
+};
+
+// reads fail (return false) past the end of the data
+struct blob_reader {
+    std::string_view in;
+
+    bool u64(std::uint64_t &v) {
+        return raw(&v, sizeof(v));
+    }
+    bool size(size_t &v) {
+        std::uint64_t n = 0;
+        if (!u64(n) || n > in.size()) // every element takes at least a byte
+            return false;
+        v = static_cast<size_t>(n);
+        return true;
+    }
+    bool str(std::string &v) {
+        size_t n = 0;
+        if (!size(n))
+            return false;
+        v = in.substr(0, n);
+        in.remove_prefix(n);
+        return true;
+    }
+    template <typename T>
+    bool vec(std::vector<T> &v) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        size_t n = 0;
+        if (!size(n) || n > in.size() / sizeof(T))
+            return false;
+        v.resize(n);
+        return raw(v.data(), n * sizeof(T));
+    }
+    bool raw(void *data, size_t size) {
+        if (size > in.size())
+            return false;
+        if (size != 0) // data of an empty vector may be null
+            std::memcpy(data, in.data(), size);
+        in.remove_prefix(size);
+        return true;
+    }
+};
+
+// what the fields of a read list may refer to, a broken entry would index outside of the list or the dump
+struct blob_limits {
+    size_t                   rows, symbols;
+    const dislua::dump_info &info;
+
+    [[nodiscard]] bool symbol(bclist::symbol s) const {
+        return static_cast<size_t>(s) < symbols;
+    }
+    [[nodiscard]] bool row(size_t i) const {
+        return i < rows || i == bclist::max_line;
+    }
+    [[nodiscard]] bool lazy(const bclist::deferred &d) const {
+        if (d.type == bclist::deferred::none)
+            return true;
+        return d.type <= bclist::deferred::label && d.proto < info.protos.size() && d.index < info.protos[d.proto].ins.size();
+    }
+};
+
+// structs are written field by field, their padding would make entries of the same list differ
+void write_deferred(blob_writer &w, const bclist::deferred &d) {
+    w.raw(&d.type, sizeof(d.type));
+    w.raw(&d.proto, sizeof(d.proto));
+    w.raw(&d.index, sizeof(d.index));
+}
+
+bool read_deferred(blob_reader &r, bclist::deferred &d) {
+    return r.raw(&d.type, sizeof(d.type)) && r.raw(&d.proto, sizeof(d.proto)) && r.raw(&d.index, sizeof(d.index));
+}
+
+void write_tokens(blob_writer &w, const std::vector<bclist::token> &tokens) {
+    w.u64(tokens.size());
+    for (const bclist::token &t: tokens) {
+        w.raw(&t.offset, sizeof(t.offset));
+        w.raw(&t.length, sizeof(t.length));
+        w.raw(&t.type, sizeof(t.type));
+        w.raw(&t.key, sizeof(t.key));
+    }
+}
+
+bool read_tokens(blob_reader &r, std::vector<bclist::token> &tokens) {
+    size_t count = 0;
+    if (!r.size(count))
+        return false;
+    tokens.resize(count);
+    for (bclist::token &t: tokens) {
+        if (!r.raw(&t.offset, sizeof(t.offset)) || !r.raw(&t.length, sizeof(t.length)) || !r.raw(&t.type, sizeof(t.type)) || !r.raw(&t.key, sizeof(t.key)))
+            return false;
     }
+    return true;
+}
+
+// divs without the text of lines, it's in the line table
+void write_div(blob_writer &w, const bclist::div &d) {
+    w.u64(static_cast<std::uint64_t>(d.key));
+    w.u64(d.tab);
+    w.str(d.header);
+    w.str(d.footer);
+    w.u64(d.lines.size());
+    for (const auto &l: d.lines) {
+        w.u64(static_cast<std::uint64_t>(l.key));
+        w.u64(l.from);
+        w.u64(l.to);
+        write_deferred(w, l.lazy);
+        w.u64(l.row);
+        w.u64(l.rows);
+    }
+    w.u64(d.additional.size());
+    for (const auto &add: d.additional)
+        write_div(w, add);
+}
+
+bool read_div(blob_reader &r, bclist::div &d, const blob_limits &limits) {
+    const size_t  rows = limits.rows;
+    std::uint64_t key = 0, tab = 0;
+    size_t        count = 0;
+    if (!r.u64(key) || !r.u64(tab) || !r.str(d.header) || !r.str(d.footer) || !r.size(count) || key >= limits.symbols)
+        return false;
+    d.key = static_cast<bclist::symbol>(key);
+    d.tab = static_cast<size_t>(tab);
+
+    d.lines.resize(count);
+    for (auto &l: d.lines) {
+        std::uint64_t lkey = 0, from = 0, to = 0, row = 0, n = 0;
+        if (!r.u64(lkey) || !r.u64(from) || !r.u64(to) || !read_deferred(r, l.lazy) || !r.u64(row) || !r.u64(n))
+            return false;
+        if (lkey >= limits.symbols || !limits.lazy(l.lazy) || row > rows || n > rows - row)
+            return false;
+        l.key  = static_cast<bclist::symbol>(lkey);
+        l.from = static_cast<size_t>(from);
+        l.to   = static_cast<size_t>(to);
+        l.row  = static_cast<size_t>(row);
+        l.rows = static_cast<size_t>(n);
+    }
+
+    if (!r.size(count))
+        return false;
+    d.additional.resize(count);
+    for (auto &add: d.additional) {
+        if (!read_div(r, add, limits))
+            return false;
+    }
+    return true;
+}
+
+void write_lines(blob_writer &w, const bclist::line_table &t) {
+    w.vec(t.from);
+    w.vec(t.to);
+    w.vec(t.keys);
+    w.vec(t.indent);
+    w.vec(t.text_begin);
+    w.str(t.arena);
+    w.vec(t.key_lines);
+    w.u64(t.lazy.size());
+    for (const bclist::deferred &d: t.lazy)
+        write_deferred(w, d);
+    w.vec(t.token_begin);
+    write_tokens(w, t.tokens);
+}
+
+// CSR index of n elements into size items
+bool valid_index(const std::vector<size_t> &begin, size_t n, size_t size) {
+    return begin.size() == n + 1 && begin.front() == 0 && begin.back() == size && std::is_sorted(begin.begin(), begin.end());
+}
+
+// the rows of the table aren't known to limits yet
+bool read_lines(blob_reader &r, bclist::line_table &t, const blob_limits &limits) {
+    size_t count = 0;
+    if (!r.vec(t.from) || !r.vec(t.to) || !r.vec(t.keys) || !r.vec(t.indent) || !r.vec(t.text_begin) || !r.str(t.arena) || !r.vec(t.key_lines) || !r.size(count))
+        return false;
+    t.lazy.resize(count);
+    for (bclist::deferred &d: t.lazy) {
+        if (!read_deferred(r, d))
+            return false;
+    }
+    if (!r.vec(t.token_begin) || !read_tokens(r, t.tokens))
+        return false;
+
+    const size_t n = t.from.size();
+    if (t.to.size() != n || t.keys.size() != n || t.indent.size() != n || t.lazy.size() != n)
+        return false;
+    if (!valid_index(t.text_begin, n, t.arena.size()) || !valid_index(t.token_begin, n, t.tokens.size()))
+        return false;
+    for (size_t i = 0; i < n; i++) {
+        if (!limits.symbol(t.keys[i]) || !limits.lazy(t.lazy[i]))
+            return false;
+        const std::uint64_t length = t.text_begin[i + 1] - t.text_begin[i];
+        for (size_t j = t.token_begin[i]; j < t.token_begin[i + 1]; j++) {
+            const bclist::token &tok = t.tokens[j];
+            if (tok.type > bclist::token::comment || !limits.symbol(tok.key) || std::uint64_t{tok.offset} + tok.length > length)
+                return false;
+        }
+    }
+    return std::all_of(t.key_lines.begin(), t.key_lines.end(), [n](size_t row) {
+        return row < n || row == bclist::max_line;
+    });
+}
+
+// the divs put their lines in the table in order, indented by their depth like line_table::add() does
+bool valid_rows(const bclist::div &d, const bclist::line_table &t, size_t tab, size_t &row) {
+    const size_t prev_tab = tab + std::max(d.tab, size_t{1}) - 1, cur_tab = tab + d.tab;
+    const auto   rows     = [&](size_t count, size_t indent) {
+        for (const size_t end = row + count; row < end; row++) {
+            if (row >= t.size() || t.indent[row] != indent)
+                return false;
+        }
+        return true;
+    };
+    const auto text_rows = [](std::string_view text) {
+        return static_cast<size_t>(std::count(text.begin(), text.end(), '\n')) + 1;
+    };
+
+    if (!d.header.empty() && !rows(text_rows(d.header), prev_tab))
+        return false;
+    for (const bclist::div::line &l: d.lines) {
+        if (l.row != row || !rows(l.rows, cur_tab))
+            return false;
+    }
+    for (const bclist::div &add: d.additional) {
+        if (!valid_rows(add, t, cur_tab, row))
+            return false;
+    }
+    return d.footer.empty() || rows(text_rows(d.footer), prev_tab);
+}
+
+// blocks and jumps of a flow of `size` instructions
+bool valid_flow(const bclist::flow &f, size_t size) {
+    if (f.targets.size() != size || f.block_of.size() != size || !valid_index(f.jump_index, size, f.jump_from.size()))
+        return false;
+    const auto below = [](size_t n) {
+        return [n](size_t i) {
+            return i < n;
+        };
+    };
+    if (!std::all_of(f.jump_from.begin(), f.jump_from.end(), below(size)) || !std::all_of(f.block_of.begin(), f.block_of.end(), below(f.blocks.size())))
+        return false;
+    return std::all_of(f.blocks.begin(), f.blocks.end(), [&](const bclist::flow::block &b) {
+        return b.first <= b.last && b.last < size && std::all_of(b.successors.begin(), b.successors.end(), below(f.blocks.size()));
+    });
+}
+
+constexpr std::string_view serialized_magic = "BCLS";
+
+std::string bclist::serialize() const {
+    blob_writer w;
+    w.out += serialized_magic;
+    w.u64(serialized_version);
+    w.u64(offset);
+
+    w.u64(symbols.size());
+    for (size_t i = 1; i < symbols.size(); i++)
+        w.str(symbols.name(static_cast<symbol>(i)));
+
+    write_lines(w, lines);
+    write_div(w, divs);
+
+    w.vec(xrefs.defs);
+    w.vec(xrefs.index);
+    w.vec(xrefs.uses);
+
+    w.u64(flows.size());
+    for (const flow &f: flows) {
+        w.vec(std::vector<std::uint8_t>(f.targets.begin(), f.targets.end()));
+        w.vec(f.block_of);
+        w.u64(f.blocks.size());
+        for (const flow::block &b: f.blocks) {
+            w.u64(b.first);
+            w.u64(b.last);
+            w.vec(b.successors);
+        }
+        w.vec(f.jump_index);
+        w.vec(f.jump_from);
+    }
+    return std::move(w.out);
+}
+
+bool bclist::deserialize(std::string_view data) {
+    clear();
+    if (!data.starts_with(serialized_magic))
+        return false;
+    data.remove_prefix(serialized_magic.size());
+
+    blob_reader   r{data};
+    const auto    fail = [this] {
+        clear();
+        return false;
+    };
+    std::uint64_t version = 0, off = 0;
+    size_t        count   = 0;
+    if (!r.u64(version) || version != serialized_version || !r.u64(off) || !r.size(count))
+        return fail();
+    offset = static_cast<size_t>(off);
+
+    // names are unique, interning them in order gives the same ids
+    std::string name;
+    for (size_t i = 1; i < count; i++) {
+        if (!r.str(name) || symbols.intern(name) != static_cast<symbol>(i))
+            return fail();
+    }
+
+    blob_limits limits{0, symbols.size(), *info};
+    if (!read_lines(r, lines, limits))
+        return fail();
+    limits.rows = lines.size();
+    if (!read_div(r, divs, limits) || !r.vec(xrefs.defs) || !r.vec(xrefs.index) || !r.vec(xrefs.uses) || !r.size(count))
+        return fail();
+    if (size_t row = 0; !valid_rows(divs, lines, 0, row) || row != lines.size())
+        return fail();
+    const auto &index = xrefs.index;
+    if (index.empty() ? !xrefs.defs.empty() : !valid_index(index, xrefs.defs.size(), xrefs.uses.size()))
+        return fail();
+    if (!std::is_sorted(xrefs.defs.begin(), xrefs.defs.end()))
+        return fail();
+    for (const xref_table::use &use: xrefs.uses) {
+        if (!limits.row(use.line) || use.proto >= info->protos.size())
+            return fail();
+    }
+
+    // a flow for each prototype, or none if the list has no flows
+    if (count != 0 && count != info->protos.size())
+        return fail();
+    flows.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        flow                     &f      = flows[i];
+        size_t                    blocks = 0;
+        std::vector<std::uint8_t> targets;
+        if (!r.vec(targets) || !r.vec(f.block_of) || !r.size(blocks))
+            return fail();
+        f.targets.assign(targets.begin(), targets.end());
+        f.blocks.resize(blocks);
+        for (flow::block &b: f.blocks) {
+            std::uint64_t first = 0, last = 0;
+            if (!r.u64(first) || !r.u64(last) || !r.vec(b.successors))
+                return fail();
+            b.first = static_cast<size_t>(first);
+            b.last  = static_cast<size_t>(last);
+        }
+        if (!r.vec(f.jump_index) || !r.vec(f.jump_from) || !valid_flow(f, info->protos[i].ins.size()))
+            return fail();
+    }
+    if (!r.in.empty())
+        return fail();
+
+    lines.build_index();
+    restored();
+    return true;
 }
 
 std::unique_ptr<bclist> bclist::get_list(const dislua::dump_info &info) {
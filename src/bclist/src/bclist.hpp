@@ -18,8 +18,14 @@
 #ifndef BCLIST_H
 #define BCLIST_H
 
-#include <map>
+#include <list>
+#include <span>
+#include <mutex>
+#include <cstdio>
+#include <cstdint>
 #include <memory>
+#include <functional>
+#include <unordered_map>
 
 #include <fmt/format.h>
 
@@ -29,11 +35,85 @@ class bclist {
 public:
     inline static constexpr size_t max_line = static_cast<size_t>(-1);
 
+    // Id of an interned name, symbol::none - no name.
+    enum class symbol : std::uint32_t { none = 0 };
+
+    // Names of keys ("proto0", "kgc_0_1", ...) in one string pool.
+    struct symbol_table {
+        symbol_table() {
+            clear();
+        }
+
+        symbol intern(std::string_view name);
+        void   clear();
+
+        [[nodiscard]] symbol           find(std::string_view name) const; // symbol::none if not found
+        [[nodiscard]] std::string_view name(symbol id) const;
+        [[nodiscard]] size_t           size() const {
+            return begin.size() - 1;
+        }
+
+    private:
+        std::string                             pool;
+        std::vector<size_t>                     begin; // name of id: pool[begin[id], begin[id + 1])
+        std::unordered_multimap<size_t, symbol> index; // hash of name -> ids
+    };
+
     struct options {
         // Maximum line length (default: 50). Number 0 remove line break.
         size_t max_length;
+        // Number of threads used by update() (default: 0). Number 0 use all hardware threads, 1 render in the calling thread.
+        size_t threads;
+        // Keep only a description of instruction lines and format the text on request (default: false).
+        bool lazy;
+        // Number of lazy lines kept formatted by text() (default: 4096).
+        size_t cache_size;
+
+        explicit options(size_t ml = 50, size_t th = 0, bool lz = false, size_t cs = 4096) : max_length(ml), threads(th), lazy(lz), cache_size(cs) {}
+    };
+
+    // Description of a line with the text formatted on request, deferred{} - usual line.
+    struct deferred {
+        enum kind : std::uint8_t { none, instruction, label };
+
+        kind          type;
+        std::uint32_t proto;
+        std::uint32_t index; // instruction
+    };
 
-        explicit options(size_t ml = 50) : max_length(ml) {}
+    // Called by update() with the number of rendered prototypes, returning false cancels the update.
+    using progress_callback = std::function<bool(size_t done, size_t total)>;
+
+    // Part of a line with a meaning known while rendering. Offsets are in bytes of the line's text,
+    // lines with tokens are ASCII.
+    struct token {
+        enum kind : std::uint8_t { none, keyword, opcode, label, name, number, string, comment };
+
+        std::uint32_t offset;
+        std::uint32_t length;
+        kind          type;
+        symbol        key; // definition of a name, symbol::none if it has no key
+    };
+
+    // Text of a line built with its tokens.
+    struct token_text {
+        std::string        text;
+        std::vector<token> tokens;
+
+        token_text &add(std::string_view str, token::kind type = token::none, symbol key = symbol::none) {
+            if (type != token::none && !str.empty())
+                tokens.push_back({static_cast<std::uint32_t>(text.size()), static_cast<std::uint32_t>(str.size()), type, key});
+            text += str;
+            return *this;
+        }
+        token_text &add(const token_text &other) {
+            for (token t: other.tokens) {
+                t.offset += static_cast<std::uint32_t>(text.size());
+                tokens.push_back(t);
+            }
+            text += other.text;
+            return *this;
+        }
     };
 
     explicit bclist(dislua::dump_info *i, const options &op = options{}) : info{i}, option{op} {}
@@ -43,15 +123,19 @@ public:
 
     struct div {
         struct line {
-            std::string text;
-            std::string key;
-            size_t      from;
-            size_t      to;
+            std::string        text;
+            symbol             key;
+            size_t             from;
+            size_t             to;
+            deferred           lazy;   // text is empty if set
+            std::vector<token> tokens; // may be empty
+            // Rows of the line in bclist::lines, set by line_table::add() that takes the text and tokens.
+            size_t row = max_line, rows = 0;
 
-            explicit line(std::string_view text = {}, size_t from = 0, size_t to = 0, std::string_view key = {}) : text{text}, key{key}, from{from}, to{to} {}
+            explicit line(std::string_view text = {}, size_t from = 0, size_t to = 0, symbol key = symbol::none) : text{text}, key{key}, from{from}, to{to}, lazy{} {}
         };
 
-        std::string       key;
+        symbol            key = symbol::none;
         size_t            tab = 0;
         std::string       header, footer;
         std::vector<line> lines;
@@ -60,25 +144,144 @@ public:
         template <typename... Args>
         void new_line(size_t from = bclist::max_line, size_t size = 0, std::string_view str = {}, Args&&... args);
         template <typename... Args>
-        void new_line(std::string_view key, size_t from = bclist::max_line, size_t size = 0, std::string_view str = {}, Args&&... args);
+        void new_line(symbol key, size_t from = bclist::max_line, size_t size = 0, std::string_view str = {}, Args&&... args);
         void empty_line(size_t p = bclist::max_line);
         void add_div(const div &d);
+        void add_div(div &&d);
 
-        [[nodiscard]] std::string string(bool from = false) const;
-        [[nodiscard]] div         only_lines() const;
-        [[nodiscard]] bool        empty() const;
+        // No header, footer and text of lines (deferred lines have text) in a div being built, see bclist::empty() for divs of a list.
+        [[nodiscard]] bool empty() const;
 
         [[nodiscard]] size_t start() const;
         [[nodiscard]] size_t end() const;
     };
 
+    // Flat lines of divs in output order. Text of all lines is kept in one arena,
+    // indentation is stored as a number of tabs and isn't a part of the text.
+    // Lines are sorted by `from`, a line of a multi-line entry has the span of the whole entry.
+    struct line_table {
+        std::vector<size_t>        from, to;
+        std::vector<symbol>        keys;
+        std::vector<std::uint32_t> indent;      // number of tabs
+        std::vector<size_t>        text_begin;  // text of line i: arena[text_begin[i], text_begin[i + 1])
+        std::string                arena;
+        std::vector<size_t>        key_lines;   // first line with the key, indexed by symbol
+        std::vector<deferred>      lazy;        // text of these lines is empty, see bclist::text()
+        std::vector<size_t>        token_begin; // tokens of line i: tokens[token_begin[i], token_begin[i + 1])
+        std::vector<token>         tokens;
+
+        line_table() {
+            clear();
+        }
+
+        [[nodiscard]] size_t size() const {
+            return from.size();
+        }
+        [[nodiscard]] bool empty() const {
+            return from.empty();
+        }
+        [[nodiscard]] std::string_view       text(size_t i) const;
+        [[nodiscard]] std::span<const token> tokens_of(size_t i) const; // empty for deferred lines
+        [[nodiscard]] size_t                 line(symbol key) const;    // max_line if not found
+
+        // First and last lines containing the address, {max_line, max_line} if none.
+        [[nodiscard]] std::pair<size_t, size_t> lines_at(size_t addr) const;
+        [[nodiscard]] size_t                    line_at(size_t addr, bool last = false) const;
+        // Bytes [from, to] of the line.
+        [[nodiscard]] std::pair<size_t, size_t> span(size_t i) const;
+
+        void clear();
+        // Add the lines of the div and rebuild the address index. Text and tokens of the div's lines
+        // are moved here, the lines keep their rows.
+        void add(div &d);
+        void add_line(std::string_view text, size_t from, size_t to, symbol key = symbol::none, size_t tab = 0, deferred lazy = {}, std::span<const token> toks = {});
+        void build_index();
+
+    private:
+        void add(div &d, size_t tab);
+
+        std::vector<size_t> reach;  // reach[i] - max of to[0..i]
+        std::vector<size_t> max_to; // segment tree of `to`, leaves start at max_to.size() / 2
+    };
+
+    // Cross references: each definition (address of an upvalue, a constant or a prototype) with its uses.
+    struct xref_table {
+        struct use {
+            size_t addr;  // address of the use
+            size_t line;  // last line containing addr, max_line if none
+            size_t proto; // prototype of the use
+        };
+
+        std::vector<size_t> defs;  // sorted
+        std::vector<size_t> index; // uses of defs[i]: uses[index[i], index[i + 1])
+        std::vector<use>    uses;
+
+        [[nodiscard]] size_t size() const {
+            return defs.size();
+        }
+        [[nodiscard]] std::span<const use> find(size_t def) const; // empty if there are no uses
+        [[nodiscard]] std::span<const use> at(size_t i) const;     // uses of defs[i]
+
+        void clear();
+        // Build from (definition, use) pairs, uses of a definition keep their order.
+        void build(std::vector<std::pair<size_t, use>> &&refs, const line_table &lines);
+    };
+
+    // Control flow of a prototype, indexed by instruction number.
+    struct flow {
+        struct block {
+            size_t              first = 0, last = 0; // instructions
+            std::vector<size_t> successors;          // blocks
+        };
+
+        std::vector<bool>   targets;  // targets[i] - some jump points at instruction i
+        std::vector<size_t> block_of; // block of each instruction
+        std::vector<block>  blocks;
+
+        // jump_from[jump_index[i]..jump_index[i + 1]) - instructions jumping to i
+        std::vector<size_t> jump_index;
+        std::vector<size_t> jump_from;
+
+        [[nodiscard]] bool                    is_target(size_t ins) const;
+        [[nodiscard]] size_t                  block_at(size_t ins) const;
+        [[nodiscard]] std::span<const size_t> jumps_to(size_t ins) const;
+    };
+
     [[nodiscard]] bool is_newline(size_t len) const {
         return option.max_length != 0 && len > option.max_length;
     }
-    [[nodiscard]] std::string full() const {
-        return divs.string();
+    // Text of all lines, deferred lines are formatted but not cached.
+    [[nodiscard]] std::string full(bool from = false) const;
+    // Write the text of all lines like full() in chunks, false on a write error.
+    bool write(std::FILE *out, bool from = false) const;
+    // Write one JSON object per line (NDJSON) in chunks, false on a write error.
+    // The base version writes the rendered lines, compilers write records built from the dump without rendering it.
+    virtual bool write_json(std::FILE *out);
+    // Text of the line without indentation, deferred lines are formatted and cached.
+    [[nodiscard]] std::string text(size_t row) const;
+    // Tokens of text(row).
+    [[nodiscard]] std::vector<token> tokens(size_t row) const;
+    // Text of a line of divs, deferred lines are formatted.
+    [[nodiscard]] std::string text(const div::line &l) const;
+    // Lines of the div with indentation (and offsets) like full().
+    [[nodiscard]] std::string string(const div &d, bool from = false) const;
+    // The div as one div of lines with indentation in their text.
+    [[nodiscard]] div only_lines(const div &d) const;
+    // No header, footer and text of lines in the div.
+    [[nodiscard]] bool empty(const div &d) const;
+    // Line with the key name, max_line if not found.
+    [[nodiscard]] size_t find_line(std::string_view name) const {
+        return lines.line(symbols.find(name));
     }
+    // Render the list, the list is left empty if the progress callback cancels it.
     virtual void update() {}
+    // Version of serialize() and of the output of update(), bump when either changes. Part of the listing cache key.
+    static constexpr std::uint64_t serialized_version = 4;
+    // Binary form of everything built by update(), for a cache on the same machine.
+    [[nodiscard]] std::string serialize() const;
+    // Load the result of update() saved by serialize() for the same dump and options, false if data is invalid
+    // or refers to rows, symbols, prototypes or instructions that don't exist.
+    bool deserialize(std::string_view data);
 
     // FIXME
     template <typename... Args>
@@ -87,23 +290,64 @@ public:
         offset += size;
     }
     template <typename... Args>
-    void new_line(div &d, std::string_view key, size_t size, std::string_view str, Args&&... args) {
+    void new_line(div &d, symbol key, size_t size, std::string_view str, Args&&... args) {
         d.new_line<Args...>(key, offset, size, str, std::forward<Args>(args)...);
         offset += size;
     }
 
-    void add_ref(std::size_t key, std::size_t value);
-    void add_ref(std::size_t key, const std::vector<std::size_t> &values);
-
-    std::map<size_t, std::vector<size_t>> refs;
-    div                                   divs;
-    dislua::dump_info                    *info;
-    options                               option;
+    xref_table         xrefs;
+    std::vector<flow>  flows; // one per prototype
+    div                divs;
+    line_table         lines; // flat divs, built by update()
+    symbol_table       symbols;
+    dislua::dump_info *info;
+    options            option;
+    progress_callback  progress; // may be called from the rendering threads, one call at a time
 
     static std::unique_ptr<bclist> get_list(const dislua::dump_info &info);
 
 protected:
+    // Call fn(i) for each i in [0, count) on option.threads threads.
+    void parallel_for(size_t count, const std::function<void(size_t)> &fn) const;
+    // Text of a deferred line, its tokens are added to tokens if it isn't null.
+    [[nodiscard]] virtual std::string materialize(const deferred &, std::vector<token> *) const {
+        return {};
+    }
+    void clear_cache();
+    // Remove everything built by update(), compilers also remove their own state.
+    virtual void clear();
+    // Rebuild the state besides the serialized one after deserialize().
+    virtual void restored() {}
+    // Line i with indentation (and offset) appended to out.
+    void append_line(std::string &out, size_t i, bool from) const;
+    // Call fn(text, from, to, key, tab) for each line of the div split like line_table::add() does.
+    template <typename F>
+    void each_line(const div &d, size_t tab, F &&fn) const;
+    // Append str as a JSON string, bytes that aren't valid UTF-8 are written as \u00XX.
+    static void json_string(std::string &out, std::string_view str);
+    // Write buf and clear it once it's longer than a chunk (or anyway if all), false on a write error.
+    static bool write_chunk(std::FILE *out, std::string &buf, bool all = false);
+
     size_t offset = 0;
+
+private:
+    // LRU of formatted deferred lines, the most recent first
+    struct text_cache {
+        struct entry {
+            size_t             row;
+            std::string        text;
+            std::vector<token> tokens;
+        };
+
+        std::mutex                                             mutex;
+        std::list<entry>                                       order;
+        std::unordered_map<size_t, std::list<entry>::iterator> rows;
+    };
+    mutable text_cache cache;
+
+    // Formatted deferred row from the cache, fn(entry) is called under the lock.
+    template <typename F>
+    auto cached(size_t row, F &&fn) const;
 };
 
 template <typename... Args>
@@ -116,7 +360,7 @@ void bclist::div::new_line(size_t from, size_t size, std::string_view str, Args&
 }
 
 template <typename... Args>
-void bclist::div::new_line(std::string_view key, size_t from, size_t size, std::string_view str, Args&&... args) {
+void bclist::div::new_line(symbol key, size_t from, size_t size, std::string_view str, Args&&... args) {
     const size_t to = size == 0 ? from : from + size - 1;
     if constexpr (sizeof...(args) == 0)
         lines.emplace_back(str, from, to, key);
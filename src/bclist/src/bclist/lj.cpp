@@ -15,8 +15,11 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <cmath>
+#include <atomic>
 #include <bitset>
 #include <numeric>
+#include <algorithm>
 #include <type_traits>
 
 #include <dislua/const.hpp>
@@ -53,15 +56,72 @@ bool is_jump(int mode) {
     return is_mode(mode, lj::bcmode::jump, 7);
 }
 
+// "JMP" after a comparison is skipped when the condition fails
+bool is_condition(std::string_view opcode) {
+    return opcode.starts_with("IS") && opcode != "ISNEXT" && opcode != "ISTYPE" && opcode != "ISNUM";
+}
+bool is_return(std::string_view opcode) {
+    return opcode.starts_with("RET") || opcode == "CALLT" || opcode == "CALLMT";
+}
+
+// names of lj::bcmode and lj::kgc for the JSON records
+constexpr std::string_view mode_names[] = {"none", "dst", "base", "var", "rbase", "uv", "lit", "lits", "pri", "num", "str", "tab", "func", "jump", "cdata"};
+constexpr std::string_view kgc_names[]  = {"proto", "table", "i64", "u64", "complex", "string"};
+
+// JSON has no infinities and NaN
+void json_number(std::string &out, double v) {
+    if (std::isfinite(v))
+        fmt::format_to(std::back_inserter(out), "{}", v);
+    else
+        out += "null";
+}
+
 class bcproto_lj {
     size_t proto_id = 0;
+    size_t offset   = 0;
     bclist_lj *parent;
 
-    std::map<std::size_t, std::vector<std::size_t>> temp_refs; // only uv/kgc/knum
+    // uses of uv/kgc/knum by index (uv, then kgc, then knum) in the order of adding,
+    // sorted by sort_temp_refs() into temp_uses[temp_index[key], temp_index[key + 1])
+    std::vector<std::pair<std::size_t, std::size_t>> temp_refs;
+    std::vector<std::size_t>                         temp_index, temp_uses;
 public:
-    explicit bcproto_lj(bclist_lj *list, size_t proto_id) : proto_id{proto_id}, parent{list} {}
+    explicit bcproto_lj(bclist_lj *list, size_t proto_id, size_t offset = 0) : proto_id{proto_id}, offset{offset}, parent{list} {}
+
+    // refs in the order of adding, moved to bclist::xrefs after rendering
+    std::vector<std::pair<std::size_t, std::size_t>> refs;
 
     void add_temp_ref(std::size_t key, std::size_t value);
+    void sort_temp_refs();
+    void add_ref(std::size_t key, std::size_t value);
+    void add_ref(std::size_t key, std::span<const std::size_t> values);
+
+    [[nodiscard]] std::span<const std::size_t> temp_refs_of(std::size_t key) const;
+
+    template <typename... Args>
+    void new_line(bclist::div &d, size_t size, std::string_view str, Args&&... args) {
+        d.new_line<Args...>(offset, size, str, std::forward<Args>(args)...);
+        offset += size;
+    }
+    template <typename... Args>
+    void new_line(bclist::div &d, bclist::symbol key, size_t size, std::string_view str, Args&&... args) {
+        d.new_line<Args...>(key, offset, size, str, std::forward<Args>(args)...);
+        offset += size;
+    }
+    void new_line(bclist::div &d, bclist::symbol key, size_t size, bclist::token_text &&line) {
+        d.new_line(key, offset, size);
+        d.lines.back().text   = std::move(line.text);
+        d.lines.back().tokens = std::move(line.tokens);
+        offset += size;
+    }
+    void new_line(bclist::div &d, size_t size, bclist::token_text &&line) {
+        new_line(d, bclist::symbol::none, size, std::move(line));
+    }
+    void new_line(bclist::div &d, size_t size, const bclist::deferred &lazy) {
+        d.new_line(offset, size);
+        d.lines.back().lazy = lazy;
+        offset += size;
+    }
 
     [[nodiscard]] static size_t knum_size(double val);
     [[nodiscard]] static size_t kgc_size(const dislua::kgc_t &v);
@@ -74,14 +134,36 @@ public:
     [[nodiscard]] size_t lineinfo_size() const;
     [[nodiscard]] size_t uvname_size() const;
     [[nodiscard]] size_t varname_size() const;
+    [[nodiscard]] size_t debug_size() const;
+    [[nodiscard]] size_t proto_size() const;
+    [[nodiscard]] size_t size() const;
+
+    // keys are stored by intern_keys() in the order: proto, uv, kgc, knum
+    [[nodiscard]] bclist::symbol proto_key() const {
+        return key_at(0);
+    }
+    [[nodiscard]] bclist::symbol uv_key(size_t i) const {
+        return key_at(1 + i);
+    }
+    [[nodiscard]] bclist::symbol kgc_key(size_t i) const {
+        return uv_key(ref().uv.size() + i);
+    }
+    [[nodiscard]] bclist::symbol knum_key(size_t i) const {
+        return kgc_key(ref().kgc.size() + i);
+    }
+    [[nodiscard]] bclist::symbol key_at(size_t i) const {
+        return parent->key_symbols[parent->key_begin[proto_id] + i];
+    }
+    // Intern the keys of the prototype and append their ids to the parent's key_symbols.
+    void intern_keys();
 
-    [[nodiscard]] std::string get_uv(size_t i) const {
+    [[nodiscard]] std::string_view get_uv(size_t i) const {
         if (i >= ref().uv.size())
             return bclist_lj::unkval;
 
-        return fmt::format("uv_{:d}_{:d}", proto_id, i);
+        return parent->symbols.name(uv_key(i));
     }
-    [[nodiscard]] std::string get_pri(size_t i) const {
+    [[nodiscard]] std::string_view get_pri(size_t i) const {
         static const std::string pri[] = {"nil", "false", "true"};
 
         if (i > 2)
@@ -94,25 +176,34 @@ public:
 
         return fmt::format("label_{:d}_{:d}", proto_id, i);
     }
-    [[nodiscard]] std::string get_knum(size_t i) const {
+    [[nodiscard]] std::string_view get_knum(size_t i) const {
         if (i >= ref().knum.size())
             return bclist_lj::unkval;
 
-        return fmt::format("knum_{:d}_{:d}", proto_id, i);
+        return parent->symbols.name(knum_key(i));
     }
-    [[nodiscard]] std::string get_kgc(size_t i, dislua::uleb128 mode) const {
+    [[nodiscard]] std::string_view get_kgc(size_t i, dislua::uleb128 mode) const {
         if (i >= ref().kgc.size() || mode != ref().kgc[i].index())
             return bclist_lj::unkval;
 
-        return fmt::format("kgc_{:d}_{:d}", proto_id, i);
+        return parent->symbols.name(kgc_key(i));
     }
 
     [[nodiscard]] const dislua::proto &ref() const {
         return parent->info->protos[proto_id];
     }
     [[nodiscard]] std::string flags() const;
-    [[nodiscard]] std::string fill_field(size_t i, int nfield);
-
+    [[nodiscard]] std::pair<int, int> get_field(size_t i, int nfield) const; // mode and value
+    void                              field_ref(size_t i, int nfield);
+    void                              ins_refs(size_t i);
+    void                              fill_field(bclist::token_text &out, size_t i, int nfield) const;
+    [[nodiscard]] bclist::token_text  ins_text(size_t i) const;
+    [[nodiscard]] bclist::token_text  label_text(size_t i) const;
+    void                              json_field(std::string &out, size_t i, int nfield) const;
+    // Records of the prototype, from its offset, written to out in chunks.
+    bool write_json(std::FILE *out, std::string &buf);
+
+    void        flow();
     bclist::div ins();
     bclist::div uvdata();
     bclist::div kgc();
@@ -122,11 +213,55 @@ public:
 };
 
 void bcproto_lj::add_temp_ref(std::size_t key, std::size_t value) {
-    auto it = temp_refs.find(key);
-    if (it == temp_refs.end()) {
-        temp_refs.emplace(key, std::vector<std::size_t>{ value });
-    } else {
-        it->second.push_back(value);
+    temp_refs.emplace_back(key, value);
+}
+
+void bcproto_lj::sort_temp_refs() {
+    // counting sort, keys of invalid fields are dropped
+    const size_t count = ref().uv.size() + ref().kgc.size() + ref().knum.size();
+    temp_index.assign(count + 1, 0);
+    for (const auto &[key, value]: temp_refs) {
+        if (key < count)
+            temp_index[key + 1]++;
+    }
+    for (size_t i = 0; i < count; i++)
+        temp_index[i + 1] += temp_index[i];
+
+    temp_uses.resize(temp_index.back());
+    std::vector<size_t> next(temp_index.begin(), temp_index.end() - 1);
+    for (const auto &[key, value]: temp_refs) {
+        if (key < count)
+            temp_uses[next[key]++] = value;
+    }
+    temp_refs.clear();
+}
+
+std::span<const std::size_t> bcproto_lj::temp_refs_of(std::size_t key) const {
+    if (key + 1 >= temp_index.size())
+        return {};
+    return std::span{temp_uses}.subspan(temp_index[key], temp_index[key + 1] - temp_index[key]);
+}
+
+void bcproto_lj::intern_keys() {
+    bclist::symbol_table        &symbols = parent->symbols;
+    std::vector<bclist::symbol> &keys    = parent->key_symbols;
+
+    keys.push_back(symbols.intern(fmt::format("proto{}", proto_id)));
+    for (size_t i = 0; i < ref().uv.size(); i++)
+        keys.push_back(symbols.intern(fmt::format("uv_{:d}_{:d}", proto_id, i)));
+    for (size_t i = 0; i < ref().kgc.size(); i++)
+        keys.push_back(symbols.intern(fmt::format("kgc_{:d}_{:d}", proto_id, i)));
+    for (size_t i = 0; i < ref().knum.size(); i++)
+        keys.push_back(symbols.intern(fmt::format("knum_{:d}_{:d}", proto_id, i)));
+}
+
+void bcproto_lj::add_ref(std::size_t key, std::size_t value) {
+    refs.emplace_back(key, value);
+}
+
+void bcproto_lj::add_ref(std::size_t key, std::span<const std::size_t> values) {
+    for (const std::size_t v: values) {
+        refs.emplace_back(key, v);
     }
 }
 
@@ -289,28 +424,29 @@ std::string bclist_lj::varname(const dislua::varname &vn) const {
     }
 }
 
-std::string bclist_lj::table_kv(const dislua::table_val_t &v) const {
-    return std::visit(dislua::detail::overloaded{
-        [](std::nullptr_t)             -> std::string { return "nil"; },
-        [](bool arg)                   -> std::string { return arg ? "true" : "false"; },
-        [](dislua::leb128 arg)         -> std::string { return std::to_string(arg); },
-        [](double arg)                 -> std::string { return std::to_string(arg); },
-        [this](const std::string &arg) -> std::string { return fix_string(arg); }
+void bclist_lj::table_kv(token_text &out, const dislua::table_val_t &v) const {
+    std::visit(dislua::detail::overloaded{
+        [&](std::nullptr_t)             { out.add("nil", token::keyword); },
+        [&](bool arg)                   { out.add(arg ? "true" : "false", token::keyword); },
+        [&](dislua::leb128 arg)         { out.add(std::to_string(arg), token::number); },
+        [&](double arg)                 { out.add(std::to_string(arg), token::number); },
+        [&](const std::string &arg)     { out.add(fix_string(arg), token::string); }
         }, v);
 }
 
-std::string bclist_lj::table(dislua::table_t t) {
-    std::string res;
-    size_t      newline = 0;
+void bclist_lj::table(token_text &out, dislua::table_t t) const {
+    token_text res;
+    size_t     newline = 0;
 
     dislua::leb128        i = 1;
     decltype(t)::iterator it;
     while (it = t.find(i++), it != t.end()) {
-        if (is_newline(res.size() - newline)) {
-            res += "\n";
-            newline = res.size();
+        if (is_newline(res.text.size() - newline)) {
+            res.add("\n");
+            newline = res.text.size();
         }
-        res += table_kv(it->second) + ", ";
+        table_kv(res, it->second);
+        res.add(", ");
         t.erase(it->first);
     }
 
@@ -318,17 +454,31 @@ std::string bclist_lj::table(dislua::table_t t) {
         if (kv.second.index() == 0) // std::nullptr_t => nil
             continue;
 
-        if (is_newline(res.size() - newline)) {
-            res += "\n";
-            newline = res.size();
+        if (is_newline(res.text.size() - newline)) {
+            res.add("\n");
+            newline = res.text.size();
         }
-        fmt::format_to(std::back_inserter(res), "[{}] = {}, ", table_kv(kv.first), table_kv(kv.second));
+        res.add("[");
+        table_kv(res, kv.first);
+        res.add("] = ");
+        table_kv(res, kv.second);
+        res.add(", ");
     }
 
-    if (!res.empty())
-        res.erase(res.size() - 2);
+    if (!res.text.empty()) // ", " has no tokens
+        res.text.erase(res.text.size() - 2);
+
+    out.add("{").add(res).add("}");
+}
 
-    return "{" + res + "}";
+void bclist_lj::json_value(std::string &out, const dislua::table_val_t &v) {
+    std::visit(dislua::detail::overloaded{
+        [&](std::nullptr_t)         { out += "null"; },
+        [&](bool arg)               { out += arg ? "true" : "false"; },
+        [&](dislua::leb128 arg)     { fmt::format_to(std::back_inserter(out), "{}", arg); },
+        [&](double arg)             { json_number(out, arg); },
+        [&](const std::string &arg) { json_string(out, arg); }
+        }, v);
 }
 
 size_t bcproto_lj::kgc_size(const dislua::kgc_t &v) {
@@ -425,6 +575,21 @@ size_t bcproto_lj::varname_size() const {
     return res;
 }
 
+size_t bcproto_lj::debug_size() const {
+    if (!parent->is_debug())
+        return 0;
+    return lineinfo_size() + uvname_size() + varname_size();
+}
+
+size_t bcproto_lj::proto_size() const {
+    return header_size() + ins_size() + uv_size() + kgc_size() + knum_size() + debug_size();
+}
+
+size_t bcproto_lj::size() const {
+    const size_t ps = proto_size();
+    return bclist_lj::uleb128_size(static_cast<dislua::uleb128>(ps)) + ps;
+}
+
 std::string bcproto_lj::flags() const {
     std::string   res;
     dislua::uchar flags = ref().flags;
@@ -442,61 +607,99 @@ std::string bcproto_lj::flags() const {
     return res;
 }
 
-std::string bcproto_lj::fill_field(size_t i, int nfield) {
-    std::string res;
-    const auto  ins  = ref().ins[i];
-    const int   mode = parent->get_mode(ins.opcode);
-    int         m = 0, field = 0;
+std::pair<int, int> bcproto_lj::get_field(size_t i, int nfield) const {
+    const auto ins  = ref().ins[i];
+    const int  mode = parent->get_mode(ins.opcode);
 
     switch (nfield) {
     case 0: // a
-        m     = mode & 7;
-        field = ins.a;
-        break;
+        return {mode & 7, ins.a};
     case 1: // b
-        m     = (mode >> 3) & lj::bcmode::MAX;
-        field = ins.b;
-        break;
+        return {(mode >> 3) & lj::bcmode::MAX, ins.b};
     case 2: // c
-        m     = (mode >> 7) & lj::bcmode::MAX;
-        field = ins.c;
-        break;
+        return {(mode >> 7) & lj::bcmode::MAX, ins.c};
     case 3: // d
-        m     = (mode >> 7) & lj::bcmode::MAX;
-        field = ins.d;
+        return {(mode >> 7) & lj::bcmode::MAX, ins.d};
+    default:
+        return {0, 0};
+    }
+}
+
+void bcproto_lj::field_ref(size_t i, int nfield) {
+    const auto [m, field] = get_field(i, nfield);
+    const size_t ufield   = static_cast<size_t>(field);
+    const size_t kgcidx   = ref().kgc.size() - 1 - ufield;
+    switch (m) {
+    case lj::bcmode::uv:
+        add_temp_ref(ufield, offset);
+        break;
+    case lj::bcmode::num:
+        add_temp_ref(ufield + ref().uv.size() + ref().kgc.size(), offset);
+        break;
+    case lj::bcmode::str:
+    case lj::bcmode::tab:
+    case lj::bcmode::func:
+        add_temp_ref(kgcidx + ref().uv.size(), offset);
         break;
     default:
         break;
     }
+}
+
+void bcproto_lj::ins_refs(size_t i) {
+    field_ref(i, 0);
+    if (has_b_field(parent->get_mode(ref().ins[i].opcode))) {
+        field_ref(i, 1);
+        field_ref(i, 2);
+    } else {
+        field_ref(i, 3);
+    }
+}
+
+void bcproto_lj::fill_field(bclist::token_text &out, size_t i, int nfield) const {
+    std::string_view    res;
+    std::string         label;
+    bclist::token::kind type = bclist::token::name;
+    bclist::symbol      key  = bclist::symbol::none;
+    auto [m, field] = get_field(i, nfield);
 
+    // keys are looked up only for operands the getters accept, others would index past the keys of the prototype
     const size_t ufield = static_cast<size_t>(field);
     const size_t kgcidx = ref().kgc.size() - 1 - ufield;
     switch (m) {
     case lj::bcmode::uv:
-        add_temp_ref(ufield, parent->offset);
         res = get_uv(ufield);
+        if (res != bclist_lj::unkval)
+            key = uv_key(ufield);
         break;
     case lj::bcmode::pri:
-        res = get_pri(ufield);
+        res  = get_pri(ufield);
+        type = bclist::token::keyword;
         break;
     case lj::bcmode::num:
-        add_temp_ref(ufield + ref().uv.size() + ref().kgc.size(), parent->offset);
         res = get_knum(ufield);
+        if (res != bclist_lj::unkval)
+            key = knum_key(ufield);
         break;
     case lj::bcmode::str:
-        add_temp_ref(kgcidx + ref().uv.size(), parent->offset);
         res = get_kgc(kgcidx, lj::kgc::string);
+        if (res != bclist_lj::unkval)
+            key = kgc_key(kgcidx);
         break;
     case lj::bcmode::tab:
-        add_temp_ref(kgcidx + ref().uv.size(), parent->offset);
         res = get_kgc(kgcidx, lj::kgc::tab);
+        if (res != bclist_lj::unkval)
+            key = kgc_key(kgcidx);
         break;
     case lj::bcmode::func:
-        add_temp_ref(kgcidx + ref().uv.size(), parent->offset);
         res = get_kgc(kgcidx, lj::kgc::child);
+        if (res != bclist_lj::unkval)
+            key = kgc_key(kgcidx);
         break;
     case lj::bcmode::jump:
-        res = get_label(ufield + i + 1 - 0x8000);
+        label = get_label(ufield + i + 1 - 0x8000);
+        res   = label;
+        type  = bclist::token::label;
         field -= 0x8000;
         break;
     // case lj::bcmode::cdata:
@@ -507,9 +710,272 @@ std::string bcproto_lj::fill_field(size_t i, int nfield) {
     }
 
     if (res.empty()) {
-        return std::to_string(field);
+        out.add(std::to_string(field), bclist::token::number);
+        return;
+    }
+    if (res == bclist_lj::unkval)
+        type = bclist::token::keyword;
+    out.add(res, type, key).add(" (").add(std::to_string(field), bclist::token::number).add(")");
+}
+
+bclist::token_text bcproto_lj::ins_text(size_t i) const {
+    const auto         ins  = ref().ins[i];
+    const std::string &opcn = parent->bcopcode(ins.opcode).first;
+    bclist::token_text res;
+
+    for (const dislua::uchar byte: {ins.opcode, ins.a, ins.c, ins.b}) {
+        res.add(res.text.empty() ? "(" : " ").add(fmt::format("{:02X}", byte), bclist::token::number);
+    }
+    res.add(") ").add(opcn, bclist::token::opcode).add("\t");
+
+    fill_field(res, i, 0);
+    res.add(", ");
+    if (has_b_field(parent->get_mode(ins.opcode))) {
+        fill_field(res, i, 1);
+        res.add(", ");
+        fill_field(res, i, 2);
+    } else {
+        fill_field(res, i, 3);
+    }
+
+    // the comment is shown when the line in source code changes
+    if (parent->is_debug() && i < ref().lineinfo.size()) {
+        const size_t line = ref().lineinfo[i], prev_line = i == 0 ? 0 : ref().lineinfo[i - 1];
+        if (line != prev_line)
+            res.add(" ").add(fmt::format("-- Line in source code: {:d}", line), bclist::token::comment);
+    }
+    return res;
+}
+
+bclist::token_text bcproto_lj::label_text(size_t i) const {
+    bclist::token_text res;
+    res.add(get_label(i), bclist::token::label).add(":");
+    return res;
+}
+
+void bcproto_lj::json_field(std::string &out, size_t i, int nfield) const {
+    static constexpr std::string_view names[] = {"a", "b", "c", "d"};
+    const auto [m, field] = get_field(i, nfield);
+    const size_t ufield   = static_cast<size_t>(field);
+    const size_t kgcidx   = ref().kgc.size() - 1 - ufield;
+    const auto   mode     = static_cast<size_t>(m) < std::size(mode_names) ? mode_names[static_cast<size_t>(m)] : mode_names[0];
+
+    std::string_view ref_name;
+    std::string      label;
+    switch (m) {
+    case lj::bcmode::uv:
+        ref_name = get_uv(ufield);
+        break;
+    case lj::bcmode::pri:
+        ref_name = get_pri(ufield);
+        break;
+    case lj::bcmode::num:
+        ref_name = get_knum(ufield);
+        break;
+    case lj::bcmode::str:
+        ref_name = get_kgc(kgcidx, lj::kgc::string);
+        break;
+    case lj::bcmode::tab:
+        ref_name = get_kgc(kgcidx, lj::kgc::tab);
+        break;
+    case lj::bcmode::func:
+        ref_name = get_kgc(kgcidx, lj::kgc::child);
+        break;
+    case lj::bcmode::jump:
+        label    = get_label(ufield + i + 1 - 0x8000);
+        ref_name = label;
+        break;
+    default:
+        break;
+    }
+
+    const int value = m == lj::bcmode::jump ? field - 0x8000 : field;
+    fmt::format_to(std::back_inserter(out), "{{\"name\":\"{}\",\"mode\":\"{}\",\"value\":{}", names[nfield], mode, value);
+    if (m == lj::bcmode::jump && ref_name != bclist_lj::unkval)
+        fmt::format_to(std::back_inserter(out), ",\"target\":{}", ufield + i + 1 - 0x8000);
+    if (ref_name == bclist_lj::unkval) {
+        out += ",\"invalid\":true";
+    } else if (!ref_name.empty()) {
+        out += ",\"ref\":";
+        bclist_lj::json_string(out, ref_name);
+    }
+    out += '}';
+}
+
+bool bcproto_lj::write_json(std::FILE *out, std::string &buf) {
+    const auto     id  = proto_id;
+    const auto    &pr  = ref();
+    const auto     put = std::back_inserter(buf);
+    // starts a record of the next size bytes
+    const auto record = [&](std::string_view type, size_t size) {
+        fmt::format_to(put, "{{\"record\":\"{}\",\"proto\":{},\"from\":{},\"to\":{}", type, id, offset, offset + size - 1);
+        offset += size;
+    };
+    const auto key = [&](std::string_view name) {
+        buf += ",\"key\":";
+        bclist_lj::json_string(buf, name);
+    };
+
+    const dislua::uleb128 psize = static_cast<dislua::uleb128>(proto_size());
+    fmt::format_to(put, "{{\"record\":\"proto\",\"proto\":{},\"from\":{},\"to\":{}", id, offset, offset + size() - 1);
+    key(parent->symbols.name(proto_key()));
+    fmt::format_to(put, ",\"flags\":{},\"numparams\":{},\"framesize\":{},\"sizeuv\":{},\"sizekgc\":{},\"sizekn\":{},\"sizebc\":{}", pr.flags, pr.numparams, pr.framesize, pr.uv.size(), pr.kgc.size(), pr.knum.size(), pr.ins.size());
+    if (parent->is_debug())
+        fmt::format_to(put, ",\"firstline\":{},\"numline\":{}", pr.firstline, pr.numline);
+    buf += "}\n";
+    offset += bclist_lj::uleb128_size(psize) + header_size();
+
+    for (size_t i = 0; i < pr.ins.size(); i++) {
+        const auto ins = pr.ins[i];
+        record("ins", sizeof(dislua::uint));
+        fmt::format_to(put, ",\"index\":{},\"opcode\":", i);
+        bclist_lj::json_string(buf, parent->bcopcode(ins.opcode).first);
+        fmt::format_to(put, ",\"op\":{},\"fields\":[", ins.opcode);
+        json_field(buf, i, 0);
+        buf += ',';
+        if (has_b_field(parent->get_mode(ins.opcode))) {
+            json_field(buf, i, 1);
+            buf += ',';
+            json_field(buf, i, 2);
+        } else {
+            json_field(buf, i, 3);
+        }
+        buf += ']';
+        if (parent->is_debug() && i < pr.lineinfo.size())
+            fmt::format_to(put, ",\"line\":{}", pr.lineinfo[i]);
+        buf += "}\n";
+        if (!bclist_lj::write_chunk(out, buf))
+            return false;
+    }
+
+    for (size_t i = 0; i < pr.uv.size(); i++) {
+        record("uv", sizeof(dislua::ushort));
+        fmt::format_to(put, ",\"index\":{}", i);
+        key(get_uv(i));
+        fmt::format_to(put, ",\"value\":{}}}\n", pr.uv[i]);
+    }
+    if (!bclist_lj::write_chunk(out, buf))
+        return false;
+
+    for (size_t i = 0; i < pr.kgc.size(); i++) {
+        const dislua::kgc_t &kgc = pr.kgc[i];
+        record("kgc", kgc_size(kgc));
+        fmt::format_to(put, ",\"index\":{}", i);
+        key(get_kgc(i, static_cast<dislua::uleb128>(kgc.index())));
+        fmt::format_to(put, ",\"kind\":\"{}\",\"value\":", kgc_names[kgc.index()]);
+        std::visit(dislua::detail::overloaded{
+            [&](const dislua::proto_id &p) {
+                fmt::format_to(put, "{}", p.id);
+                if (p.id < parent->proto_offsets.size()) {
+                    buf += ",\"ref\":";
+                    bclist_lj::json_string(buf, parent->symbols.name(parent->proto_symbol(p.id)));
+                }
+            },
+            [&](const dislua::table_t &t) {
+                // pairs, the keys aren't only strings
+                buf += '[';
+                bool first = true;
+                for (const auto &[k, v]: t) {
+                    buf += first ? "[" : ",[";
+                    bclist_lj::json_value(buf, k);
+                    buf += ',';
+                    bclist_lj::json_value(buf, v);
+                    buf += ']';
+                    first = false;
+                }
+                buf += ']';
+            },
+            [&](long long v)            { fmt::format_to(put, "{}", v); },
+            [&](unsigned long long v)   { fmt::format_to(put, "{}", v); },
+            [&](std::complex<double> v) {
+                buf += "{\"re\":";
+                json_number(buf, v.real());
+                buf += ",\"im\":";
+                json_number(buf, v.imag());
+                buf += '}';
+            },
+            [&](const std::string &str) { bclist_lj::json_string(buf, str); }
+        }, kgc);
+        buf += "}\n";
+        if (!bclist_lj::write_chunk(out, buf))
+            return false;
+    }
+
+    for (size_t i = 0; i < pr.knum.size(); i++) {
+        record("knum", knum_size(pr.knum[i]));
+        fmt::format_to(put, ",\"index\":{}", i);
+        key(get_knum(i));
+        buf += ",\"value\":";
+        json_number(buf, pr.knum[i]);
+        buf += "}\n";
+    }
+
+    offset += debug_size();
+    return bclist_lj::write_chunk(out, buf);
+}
+
+void bcproto_lj::flow() {
+    bclist::flow &res  = parent->flows[proto_id];
+    const auto   &code = ref().ins;
+    const size_t  size = code.size();
+
+    const auto target = [&](size_t i) {
+        return static_cast<size_t>(code[i].d) + 1 + i - 0x8000;
+    };
+
+    // jump targets and block leaders
+    std::vector<bool> leaders(size, false);
+    res.targets.assign(size, false);
+    res.jump_index.assign(size + 1, 0);
+    for (size_t i = 0; i < size; i++) {
+        const auto ins = code[i];
+        if (is_jump(parent->get_mode(ins.opcode))) {
+            if (const size_t t = target(i); t < size) {
+                res.targets[t] = leaders[t] = true;
+                res.jump_index[t + 1]++;
+            }
+        } else if (!is_return(parent->bcopcode(ins.opcode).first)) {
+            continue;
+        }
+        if (i + 1 < size)
+            leaders[i + 1] = true;
+    }
+
+    std::partial_sum(res.jump_index.begin(), res.jump_index.end(), res.jump_index.begin());
+    res.jump_from.resize(res.jump_index.back());
+    std::vector<size_t> fill(res.jump_index.begin(), res.jump_index.end() - 1);
+
+    res.blocks.clear();
+    res.block_of.resize(size);
+    for (size_t i = 0; i < size; i++) {
+        if (i == 0 || leaders[i]) {
+            if (!res.blocks.empty())
+                res.blocks.back().last = i - 1;
+            res.blocks.push_back({i, i, {}});
+        }
+        res.block_of[i] = res.blocks.size() - 1;
+        if (is_jump(parent->get_mode(code[i].opcode)))
+            if (const size_t t = target(i); t < size)
+                res.jump_from[fill[t]++] = i;
+    }
+    if (!res.blocks.empty())
+        res.blocks.back().last = size - 1;
+
+    // successors
+    for (bclist::flow::block &b: res.blocks) {
+        const size_t       i    = b.last;
+        const std::string &opcn = parent->bcopcode(code[i].opcode).first;
+        bool               next = !is_return(opcn);
+        if (is_jump(parent->get_mode(code[i].opcode))) {
+            if (const size_t t = target(i); t < size)
+                b.successors.push_back(res.block_of[t]);
+            const bool conditional = i != 0 && is_condition(parent->bcopcode(code[i - 1].opcode).first);
+            if (opcn == "UCLO" || (opcn == "JMP" && !conditional))
+                next = false;
+        }
+        if (next && i + 1 < size && std::find(b.successors.begin(), b.successors.end(), res.block_of[i + 1]) == b.successors.end())
+            b.successors.push_back(res.block_of[i + 1]);
     }
-    return fmt::format("{:s} ({:d})", res, field);
 }
 
 bclist::div bcproto_lj::ins() {
@@ -518,49 +984,31 @@ bclist::div bcproto_lj::ins() {
         return res;
     res.header = ".ins";
 
-    const size_t start     = parent->offset;
+    const size_t start     = offset;
     const auto   to_offset = [start](size_t i) {
         return start + i * sizeof(dislua::uint);
     };
 
-    std::vector<size_t> jumps;
-    for (size_t i = 0; i < ref().ins.size(); i++) {
-        const auto ins = ref().ins[i];
-        if (is_jump(parent->get_mode(ins.opcode)))
-            jumps.emplace_back(static_cast<size_t>(ins.d) + 1 + i - 0x8000);
-    }
+    const bclist::flow &fl   = parent->flows[proto_id];
+    const bool          lazy = parent->option.lazy;
+    const auto          id   = static_cast<std::uint32_t>(proto_id);
 
-    size_t prev_line = 0;
     for (size_t i = 0; i < ref().ins.size(); i++) {
-        const auto ins = ref().ins[i];
-        if (std::find(jumps.begin(), jumps.end(), i) != jumps.end()) { // is a label
+        const auto index = static_cast<std::uint32_t>(i);
+        if (fl.is_target(i)) { // is a label
             if (!res.lines.empty())
                 res.empty_line(to_offset(i) - sizeof(dislua::uint));
-            parent->new_line(res, 0, "{:s}:", get_label(i));
+            if (lazy)
+                new_line(res, 0, bclist::deferred{bclist::deferred::label, id, index});
+            else
+                new_line(res, 0, label_text(i));
         }
 
-        const std::string &opcn = parent->bcopcode(ins.opcode).first;
-        std::string        fields, comment;
-        if (parent->is_debug() && ref().lineinfo[i] != prev_line) {
-            prev_line = ref().lineinfo[i];
-            comment   = fmt::format(" -- Line in source code: {:d}", prev_line);
-        }
-
-        const std::string field_a = fill_field(i, 0);
-        fields.append(field_a + ", ");
-
-        if (has_b_field(parent->get_mode(ins.opcode))) {
-            const std::string field_b = fill_field(i, 1);
-            const std::string field_c = fill_field(i, 2);
-
-            fields.append(field_b + ", ");
-            fields.append(field_c);
-        } else {
-            const std::string field_d = fill_field(i, 3);
-            fields.append(field_d);
-        }
-
-        parent->new_line(res, sizeof(dislua::uint), "({:02X} {:02X} {:02X} {:02X}) {:s}\t{:s}{:s}", ins.opcode, ins.a, ins.c, ins.b, opcn, fields, comment);
+        ins_refs(i);
+        if (lazy)
+            new_line(res, sizeof(dislua::uint), bclist::deferred{bclist::deferred::instruction, id, index});
+        else
+            new_line(res, sizeof(dislua::uint), ins_text(i));
     }
     res.empty_line();
 
@@ -574,13 +1022,12 @@ bclist::div bcproto_lj::uvdata() {
     res.header = ".uvdata";
 
     for (size_t i = 0; i < ref().uv.size(); i++) {
-        auto refs = temp_refs.find(i);
-        if (refs != temp_refs.end()) {
-            parent->add_ref(parent->offset, refs->second);
-        }
+        add_ref(offset, temp_refs_of(i));
 
         const dislua::ushort uv = ref().uv[i];
-        parent->new_line(res, get_uv(i), sizeof(dislua::ushort), "{} = 0x{:04X}", get_uv(i), uv);
+        bclist::token_text   line;
+        line.add(get_uv(i), bclist::token::name, uv_key(i)).add(" = ").add(fmt::format("0x{:04X}", uv), bclist::token::number);
+        new_line(res, uv_key(i), sizeof(dislua::ushort), std::move(line));
     }
     res.empty_line();
 
@@ -594,26 +1041,28 @@ bclist::div bcproto_lj::kgc() {
     res.header = ".kgc";
 
     for (size_t i = 0; i < ref().kgc.size(); i++) {
-        auto refs = temp_refs.find(i + ref().uv.size());
-        if (refs != temp_refs.end()) {
-            parent->add_ref(parent->offset, refs->second);
-        }
+        add_ref(offset, temp_refs_of(i + ref().uv.size()));
 
         const dislua::kgc_t  &kgc   = ref().kgc[i];
         const dislua::uleb128 index = static_cast<dislua::uleb128>(kgc.index());
-        const std::string val = std::visit(dislua::detail::overloaded{
-            [&](const dislua::proto_id &id) -> std::string {
-                parent->add_ref(parent->divs.additional[id.id + 2].start(), parent->offset);
-                return "proto" + std::to_string(id.id);
+        bclist::token_text    line;
+        line.add(get_kgc(i, index), bclist::token::name, kgc_key(i)).add(" = ");
+        std::visit(dislua::detail::overloaded{
+            [&](const dislua::proto_id &id) {
+                bclist::symbol key = bclist::symbol::none;
+                if (id.id < parent->proto_offsets.size()) {
+                    add_ref(parent->proto_offsets[id.id], offset);
+                    key = parent->proto_symbol(id.id);
+                }
+                line.add("proto" + std::to_string(id.id), bclist::token::name, key);
             },
-            [&](const dislua::table_t &t)   -> std::string { return parent->table(t); },
-            [](long long v)                 -> std::string { return std::to_string(v); },
-            [](unsigned long long v)        -> std::string { return std::to_string(v); },
-            [](std::complex<double> v)      -> std::string { return fmt::format("({}+{}i)", v.real(), v.imag()); },
-            [&](const std::string &str)     -> std::string { return parent->fix_string(str); }
+            [&](const dislua::table_t &t)   { parent->table(line, t); },
+            [&](long long v)                { line.add(std::to_string(v), bclist::token::number); },
+            [&](unsigned long long v)       { line.add(std::to_string(v), bclist::token::number); },
+            [&](std::complex<double> v)     { line.add(fmt::format("({}+{}i)", v.real(), v.imag()), bclist::token::number); },
+            [&](const std::string &str)     { line.add(parent->fix_string(str), bclist::token::string); }
         }, kgc);
-        std::string kgc_index = get_kgc(i, index);
-        parent->new_line(res, kgc_index, kgc_size(kgc), "{} = {}", kgc_index, val);
+        new_line(res, kgc_key(i), kgc_size(kgc), std::move(line));
     }
     res.empty_line();
 
@@ -627,10 +1076,7 @@ bclist::div bcproto_lj::knum() {
     res.header = ".knum";
 
     for (size_t i = 0; i < ref().knum.size(); i++) {
-        auto refs = temp_refs.find(i + ref().uv.size() + ref().kgc.size());
-        if (refs != temp_refs.end()) {
-            parent->add_ref(parent->offset, refs->second);
-        }
+        add_ref(offset, temp_refs_of(i + ref().uv.size() + ref().kgc.size()));
 
         const double num = ref().knum[i], snum = static_cast<double>(static_cast<int>(num)); // signed value
         size_t       size;
@@ -642,7 +1088,9 @@ bclist::div bcproto_lj::knum() {
             size = bclist_lj::uleb128_33_size(v[0]) + bclist_lj::uleb128_size(v[1]);
         }
 
-        parent->new_line(res, get_knum(i), size, "{} = {}", get_knum(i), num);
+        bclist::token_text line;
+        line.add(get_knum(i), bclist::token::name, knum_key(i)).add(" = ").add(fmt::format("{}", num), bclist::token::number);
+        new_line(res, knum_key(i), size, std::move(line));
     }
     res.empty_line();
 
@@ -653,42 +1101,42 @@ bclist::div bcproto_lj::operator()() {
     bclist::div res;
     res.tab = 1;
     res.footer = "end\n";
-    res.key = fmt::format("proto{}", proto_id);
-    res.header = res.key + " do";
+    res.key = proto_key();
+    res.header = fmt::format("{} do", parent->symbols.name(res.key));
 
     bclist::div pinfo;
     pinfo.header = ".info";
 
-    dislua::uleb128 debug_size = 0;
-    if (parent->is_debug())
-        debug_size += static_cast<dislua::uleb128>(lineinfo_size() + uvname_size() + varname_size());
+    const dislua::uleb128 dbgsize = static_cast<dislua::uleb128>(debug_size());
 
     // prototype size
-    dislua::uleb128 proto_size = static_cast<dislua::uleb128>(header_size() + ins_size() + uv_size() + kgc_size() + knum_size()) + debug_size;
-    parent->new_line(pinfo, bclist_lj::uleb128_size(proto_size), "size = {:08X}", proto_size);
+    const dislua::uleb128 psize = static_cast<dislua::uleb128>(proto_size());
+    new_line(pinfo, bclist_lj::uleb128_size(psize), "size = {:08X}", psize);
     if (dislua::uchar fl = ref().flags)
-        parent->new_line(pinfo, sizeof(dislua::uchar), "flags = 0b{} -- {}", std::bitset<8>(fl).to_string(), flags());
+        new_line(pinfo, sizeof(dislua::uchar), "flags = 0b{} -- {}", std::bitset<8>(fl).to_string(), flags());
     else
-        parent->new_line(pinfo, sizeof(dislua::uchar), "flags = 0");
+        new_line(pinfo, sizeof(dislua::uchar), "flags = 0");
 
     dislua::uleb128 sizekgc = static_cast<dislua::uleb128>(ref().kgc.size()), sizekn = static_cast<dislua::uleb128>(ref().knum.size()),
                     sizebc = static_cast<dislua::uleb128>(ref().ins.size());
-    parent->new_line(pinfo, sizeof(dislua::uchar), "numparams = {:d}", ref().numparams);
-    parent->new_line(pinfo, sizeof(dislua::uchar), "framesize = {:d}", ref().framesize);
-    parent->new_line(pinfo, sizeof(dislua::uchar), "sizeuv = {:d}", ref().uv.size());
-    parent->new_line(pinfo, bclist_lj::uleb128_size(sizekgc), "sizekgc = {:d}", sizekgc);
-    parent->new_line(pinfo, bclist_lj::uleb128_size(sizekn), "sizekn = {:d}", sizekn);
-    parent->new_line(pinfo, bclist_lj::uleb128_size(sizebc), "sizebc = {:d}", sizebc);
+    new_line(pinfo, sizeof(dislua::uchar), "numparams = {:d}", ref().numparams);
+    new_line(pinfo, sizeof(dislua::uchar), "framesize = {:d}", ref().framesize);
+    new_line(pinfo, sizeof(dislua::uchar), "sizeuv = {:d}", ref().uv.size());
+    new_line(pinfo, bclist_lj::uleb128_size(sizekgc), "sizekgc = {:d}", sizekgc);
+    new_line(pinfo, bclist_lj::uleb128_size(sizekn), "sizekn = {:d}", sizekn);
+    new_line(pinfo, bclist_lj::uleb128_size(sizebc), "sizebc = {:d}", sizebc);
 
     if (parent->is_debug()) {
-        parent->new_line(pinfo, bclist_lj::uleb128_size(debug_size), "sizedbg = {:d}", debug_size);
-        parent->new_line(pinfo, bclist_lj::uleb128_size(ref().firstline), "firstline = {:d}", ref().firstline);
-        parent->new_line(pinfo, bclist_lj::uleb128_size(ref().numline), "numline = {:d}", ref().numline);
+        new_line(pinfo, bclist_lj::uleb128_size(dbgsize), "sizedbg = {:d}", dbgsize);
+        new_line(pinfo, bclist_lj::uleb128_size(ref().firstline), "firstline = {:d}", ref().firstline);
+        new_line(pinfo, bclist_lj::uleb128_size(ref().numline), "numline = {:d}", ref().numline);
     }
     pinfo.empty_line();
 
     res.add_div(pinfo);
+    flow();
     res.add_div(ins());
+    sort_temp_refs();
     res.add_div(uvdata());
     res.add_div(kgc());
     res.add_div(knum());
@@ -697,7 +1145,7 @@ bclist::div bcproto_lj::operator()() {
     // remove last empty line
     res.additional.back().lines.pop_back();
 
-    parent->offset += debug_size;
+    offset += dbgsize;
     return res;
 }
 
@@ -705,10 +1153,7 @@ bclist::div bcproto_lj::operator()() {
 // 1: header info
 // 2..: prototypes
 void bclist_lj::update() {
-    divs = {};
-    refs.clear();
-    offset = 0;
-    temp_protos_id.clear();
+    clear();
 
     div compiler;
     compiler.empty_line(offset);
@@ -734,10 +1179,140 @@ void bclist_lj::update() {
     header.empty_line();
     divs.add_div(header);
 
-    for (size_t i = 0; i < info->protos.size(); ++i) {
-        bcproto_lj p{this, i};
+    const size_t count = info->protos.size();
+    layout();
+
+    flows.assign(count, {});
+    std::vector<bcproto_lj>  protos;
+    std::vector<bclist::div> rendered(count);
+    protos.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        protos.emplace_back(this, i, proto_offsets[i]);
+    }
 
-        divs.add_div(p());
+    // rendering stops at the next prototype once the callback returns false
+    std::atomic_bool stop = progress && !progress(0, count);
+    size_t           done = 0;
+    std::mutex       progress_mutex;
+    parallel_for(count, [&](size_t i) {
+        if (stop)
+            return;
+        rendered[i] = protos[i]();
+        if (progress) {
+            std::lock_guard lock{progress_mutex};
+            if (!stop && !progress(++done, count))
+                stop = true;
+        }
+    });
+    if (stop) {
+        clear();
+        return;
+    }
+
+    std::vector<std::pair<size_t, xref_table::use>> all_refs;
+    for (size_t i = 0; i < count; ++i) {
+        divs.add_div(std::move(rendered[i]));
+        for (const auto &[key, value]: protos[i].refs) {
+            all_refs.emplace_back(key, xref_table::use{value, max_line, i});
+        }
         temp_protos_id.emplace_back(i);
     }
-}
\ No newline at end of file
+
+    lines.clear();
+    lines.add(divs);
+    xrefs.build(std::move(all_refs), lines);
+}
+
+void bclist_lj::clear() {
+    bclist::clear();
+    temp_protos_id.clear();
+    // write_json() lays the prototypes out again
+    proto_offsets.clear();
+    key_symbols.clear();
+    key_begin.clear();
+}
+
+// sizes of the prototypes are known before rendering, so each one gets
+// its own start offset and can be rendered independently of the others
+void bclist_lj::layout() {
+    const size_t count = info->protos.size();
+    proto_offsets.clear();
+    proto_offsets.reserve(count);
+    key_symbols.clear();
+    key_begin.clear();
+    key_begin.reserve(count + 1);
+    for (size_t i = 0; i < count; ++i) {
+        bcproto_lj p{this, i};
+        proto_offsets.emplace_back(offset);
+        key_begin.emplace_back(key_symbols.size());
+        p.intern_keys();
+        offset += p.size();
+    }
+    key_begin.emplace_back(key_symbols.size());
+}
+
+bool bclist_lj::write_json(std::FILE *out) {
+    if (proto_offsets.size() != info->protos.size()) { // not rendered
+        offset = header_size();
+        layout();
+    }
+
+    std::string buf;
+    fmt::format_to(std::back_inserter(buf), "{{\"record\":\"header\",\"from\":0,\"to\":{},\"compiler\":\"luajit\",\"version\":{},\"flags\":{}", header_size() - 1, info->version, info->header.flags);
+    if (is_debug()) {
+        buf += ",\"debug_name\":";
+        json_string(buf, info->header.debug_name);
+    }
+    buf += "}\n";
+
+    for (size_t i = 0; i < info->protos.size(); i++) {
+        bcproto_lj p{this, i, proto_offsets[i]};
+        if (!p.write_json(out, buf))
+            return false;
+    }
+    return write_chunk(out, buf, true);
+}
+
+size_t bclist_lj::header_size() const {
+    size_t res = 3 + 1 + uleb128_size(info->header.flags); // signature, version, flags
+    if (is_debug()) {
+        const size_t s = info->header.debug_name.size();
+        res += uleb128_size(static_cast<dislua::uleb128>(s)) + s;
+    }
+    return res;
+}
+
+void bclist_lj::restored() {
+    // the symbols are already interned, only the ids are looked up
+    const size_t end = offset;
+    offset           = header_size();
+    layout();
+    offset = end;
+
+    temp_protos_id.resize(info->protos.size());
+    std::iota(temp_protos_id.begin(), temp_protos_id.end(), size_t{0});
+}
+
+std::string bclist_lj::materialize(const deferred &d, std::vector<token> *tokens) const {
+    if (d.proto >= info->protos.size())
+        return unkval;
+    // formatting only reads the list, the prototype doesn't change it
+    const bcproto_lj p{const_cast<bclist_lj *>(this), d.proto};
+    if (d.index >= p.ref().ins.size())
+        return unkval;
+
+    token_text res;
+    switch (d.type) {
+    case deferred::instruction:
+        res = p.ins_text(d.index);
+        break;
+    case deferred::label:
+        res = p.label_text(d.index);
+        break;
+    default:
+        break;
+    }
+    if (tokens)
+        *tokens = std::move(res.tokens);
+    return std::move(res.text);
+}
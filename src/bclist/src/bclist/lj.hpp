@@ -34,10 +34,12 @@ protected:
     [[nodiscard]] int           get_mode(dislua::uchar opcode) const;
 
     [[nodiscard]] std::string header_flags() const;
+    [[nodiscard]] size_t      header_size() const;
     [[nodiscard]] std::string fix_string(std::string_view str) const;
     [[nodiscard]] std::string varname(const dislua::varname &vn) const;
-    [[nodiscard]] std::string table_kv(const dislua::table_val_t &v) const;
-    std::string               table(dislua::table_t t);
+    void                      table_kv(token_text &out, const dislua::table_val_t &v) const;
+    void                      table(token_text &out, dislua::table_t t) const;
+    static void               json_value(std::string &out, const dislua::table_val_t &v);
 
 public:
     explicit bclist_lj(dislua::dump_info *i) : bclist{i} {}
@@ -46,9 +48,27 @@ public:
     static inline const std::string                 unkval = "invalid";
 
     void update() override;
+    // Records of the header, prototypes, instructions and constants, the list doesn't need to be rendered.
+    bool write_json(std::FILE *out) override;
+
+protected:
+    [[nodiscard]] std::string materialize(const deferred &d, std::vector<token> *tokens) const override;
+    void                      restored() override;
+
+    void clear() override;
+    // Start offsets and keys of the prototypes.
+    void layout();
 
 private:
     std::vector<size_t> temp_protos_id;
+    std::vector<size_t> proto_offsets; // start offset of each prototype
+    // keys of prototype i: key_symbols[key_begin[i], key_begin[i + 1]), see bcproto_lj::intern_keys()
+    std::vector<symbol> key_symbols;
+    std::vector<size_t> key_begin;
+
+    [[nodiscard]] symbol proto_symbol(size_t id) const {
+        return key_symbols[key_begin[id]];
+    }
 
     friend class bcproto_lj;
 };
@@ -0,0 +1,213 @@
+// Luad - Disassembler for compiled Lua scripts.
+// https://github.com/imring/Luad
+// Copyright (C) 2021-2023 Vitaliy Vorobets
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// bclist-bench: time and heap allocations of each phase of building a listing, for synthetic
+// dumps of growing size and the files given on the command line. One row per input and phase,
+// the columns don't change so outputs of two builds can be compared with diff or a spreadsheet.
+
+#include <new>
+#include <atomic>
+#include <variant>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+#include <filesystem>
+
+#include <fmt/core.h>
+
+#include "bclist.hpp"
+#include "bclist/lj.hpp"
+#include "synthetic.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+std::atomic<size_t> allocations{0}, allocated{0};
+} // namespace
+
+// every allocation of the process is counted, the phases run in the calling thread
+void *operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated.fetch_add(size, std::memory_order_relaxed);
+    if (void *p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc{};
+}
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+    std::free(p);
+}
+
+namespace {
+constexpr auto   min_time = std::chrono::milliseconds{200};
+constexpr size_t min_runs = 3;
+
+volatile size_t sink; // keeps the results from being optimized out
+
+// exposes the renderers of single values
+class bench_list : public bclist_lj {
+public:
+    explicit bench_list(dislua::dump_info *i) : bclist_lj{i} {}
+
+    using bclist_lj::fix_string;
+    using bclist_lj::table;
+};
+
+struct result {
+    size_t runs = 0;
+    double best = 0, mean = 0;    // microseconds
+    size_t allocs = 0, bytes = 0; // per run
+};
+
+// fn() is repeated for at least min_time, its result is destroyed outside of the measurement
+template <typename F>
+result measure(F &&fn) {
+    using clock = std::chrono::steady_clock;
+
+    result     r;
+    double     total = 0;
+    const auto end   = clock::now() + min_time;
+    do {
+        const size_t count = allocations.load(std::memory_order_relaxed), bytes = allocated.load(std::memory_order_relaxed);
+        const auto   start = clock::now();
+        const auto   value = fn();
+        const double us    = std::chrono::duration<double, std::micro>(clock::now() - start).count();
+        r.allocs           = allocations.load(std::memory_order_relaxed) - count;
+        r.bytes            = allocated.load(std::memory_order_relaxed) - bytes;
+
+        if constexpr (std::is_integral_v<std::decay_t<decltype(value)>>)
+            sink = value;
+        else
+            sink = value.size();
+        r.best = r.runs == 0 ? us : std::min(r.best, us);
+        total += us;
+        r.runs++;
+    } while (r.runs < min_runs || clock::now() < end);
+    r.mean = total / static_cast<double>(r.runs);
+    return r;
+}
+
+void print(std::string_view input, std::string_view phase, const result &r) {
+    fmt::print("{:<24} {:<12} {:>6} {:>12.1f} {:>12.1f} {:>10} {:>12}\n", input, phase, r.runs, r.best, r.mean, r.allocs, r.bytes);
+}
+
+std::vector<dislua::uchar> read_file(const fs::path &path) {
+    std::ifstream file{path, std::ios::binary};
+    return {std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+}
+
+bool run(std::string_view input, const std::vector<dislua::uchar> &bytes) {
+    const dislua::buffer buf(bytes.begin(), bytes.end());
+
+    auto info = dislua::read_all(buf);
+    if (!info || info->compiler() != dislua::compilers::luajit) {
+        fmt::print(stderr, "{}: unsupported file\n", input);
+        return false;
+    }
+
+    print(input, "read", measure([&] {
+        return dislua::read_all(buf)->protos.size();
+    }));
+    bench_list list{info.release()};
+    list.option.threads = 1;
+
+    print(input, "update", measure([&] {
+        list.update();
+        return list.lines.size();
+    }));
+    print(input, "only_lines", measure([&] {
+        return list.only_lines(list.divs).lines.size();
+    }));
+    print(input, "div_string", measure([&] {
+        return list.string(list.divs);
+    }));
+    print(input, "fix_string", measure([&] {
+        size_t size = 0;
+        for (const dislua::proto &pr: list.info->protos) {
+            for (const dislua::kgc_t &k: pr.kgc) {
+                if (const auto *str = std::get_if<std::string>(&k))
+                    size += list.fix_string(*str).size();
+            }
+        }
+        return size;
+    }));
+    print(input, "table", measure([&] {
+        size_t size = 0;
+        for (const dislua::proto &pr: list.info->protos) {
+            for (const dislua::kgc_t &k: pr.kgc) {
+                if (const auto *tab = std::get_if<dislua::table_t>(&k)) {
+                    bclist::token_text out;
+                    list.table(out, *tab);
+                    size += out.text.size();
+                }
+            }
+        }
+        return size;
+    }));
+    // what the views do on a click or a jump: every byte of the file to its lines, every prototype by name
+    print(input, "line_at", measure([&] {
+        size_t found = 0;
+        for (size_t addr = 0; addr < bytes.size(); addr++)
+            found += list.lines.line_at(addr) != bclist::max_line;
+        return found;
+    }));
+    print(input, "find_line", measure([&] {
+        size_t found = 0;
+        for (size_t i = 0; i < list.info->protos.size(); i++)
+            found += list.find_line(fmt::format("proto{}", i)) != bclist::max_line;
+        return found;
+    }));
+    return true;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+    // prototypes x instructions
+    constexpr std::pair<size_t, size_t> sizes[] = {{8, 64}, {64, 256}, {512, 1024}};
+
+    fmt::print("{:<24} {:<12} {:>6} {:>12} {:>12} {:>10} {:>12}\n", "input", "phase", "runs", "best_us", "mean_us", "allocs", "bytes");
+    int code = 0;
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            const fs::path path = argv[i];
+            if (!run(path.filename().string(), read_file(path)))
+                code = 1;
+        }
+    } else {
+        for (const auto &[protos, count]: sizes) {
+            dump_shape shape;
+            shape.protos       = protos;
+            shape.instructions = count;
+            if (!run(fmt::format("synthetic-{}x{}", protos, count), make_dump(shape)))
+                code = 1;
+        }
+    }
+    return code;
+}
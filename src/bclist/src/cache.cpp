@@ -0,0 +1,263 @@
+// Luad - Disassembler for compiled Lua scripts.
+// https://github.com/imring/Luad
+// Copyright (C) 2021-2023 Vitaliy Vorobets
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <bit>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+#include "cache.hpp"
+
+namespace fs = std::filesystem;
+
+fs::path listing_cache::default_dir() {
+#ifdef _WIN32
+    char  *base = nullptr;
+    size_t len  = 0;
+    if (_dupenv_s(&base, &len, "LOCALAPPDATA") != 0 || !base)
+        return {};
+    fs::path res = fs::path{base} / "bclist";
+    std::free(base);
+    return res;
+#else
+    if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+        return fs::path{xdg} / "bclist";
+    if (const char *home = std::getenv("HOME"); home && *home)
+        return fs::path{home} / ".cache" / "bclist";
+    return {};
+#endif
+}
+
+namespace {
+// SHA-256 (FIPS 180-4)
+class sha256 {
+public:
+    void update(std::span<const unsigned char> data) {
+        length += data.size();
+        while (!data.empty()) {
+            if (used == 0 && data.size() >= buf.size()) { // whole blocks aren't copied
+                block(data.data());
+                data = data.subspan(buf.size());
+                continue;
+            }
+            const size_t n = std::min(buf.size() - used, data.size());
+            std::memcpy(buf.data() + used, data.data(), n);
+            used += n;
+            data = data.subspan(n);
+            if (used == buf.size()) {
+                block(buf.data());
+                used = 0;
+            }
+        }
+    }
+
+    std::array<unsigned char, 32> finish() {
+        const std::uint64_t bits = length * 8;
+        buf[used++]              = 0x80;
+        if (used > 56) {
+            std::fill(buf.begin() + static_cast<std::ptrdiff_t>(used), buf.end(), 0);
+            block(buf.data());
+            used = 0;
+        }
+        std::fill(buf.begin() + static_cast<std::ptrdiff_t>(used), buf.begin() + 56, 0);
+        for (size_t i = 0; i < 8; i++)
+            buf[56 + i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+        block(buf.data());
+
+        std::array<unsigned char, 32> res;
+        for (size_t i = 0; i < res.size(); i++)
+            res[i] = static_cast<unsigned char>(h[i / 4] >> (24 - 8 * (i % 4)));
+        return res;
+    }
+
+private:
+    void block(const unsigned char *p) {
+        static constexpr std::uint32_t k[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+        std::uint32_t w[64];
+        for (size_t i = 0; i < 16; i++)
+            w[i] = std::uint32_t{p[4 * i]} << 24 | std::uint32_t{p[4 * i + 1]} << 16 | std::uint32_t{p[4 * i + 2]} << 8 | std::uint32_t{p[4 * i + 3]};
+        for (size_t i = 16; i < 64; i++) {
+            const std::uint32_t s0 = std::rotr(w[i - 15], 7) ^ std::rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const std::uint32_t s1 = std::rotr(w[i - 2], 17) ^ std::rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i]                   = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        std::uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+        for (size_t i = 0; i < 64; i++) {
+            const std::uint32_t t1 = hh + (std::rotr(e, 6) ^ std::rotr(e, 11) ^ std::rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+            const std::uint32_t t2 = (std::rotr(a, 2) ^ std::rotr(a, 13) ^ std::rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            hh                     = g;
+            g                      = f;
+            f                      = e;
+            e                      = d + t1;
+            d                      = c;
+            c                      = b;
+            b                      = a;
+            a                      = t1 + t2;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+        h[5] += f;
+        h[6] += g;
+        h[7] += hh;
+    }
+
+    std::array<std::uint32_t, 8>  h{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    std::array<unsigned char, 64> buf{};
+    size_t                        used   = 0;
+    std::uint64_t                 length = 0; // in bytes
+};
+} // namespace
+
+listing_cache::dump_key listing_cache::key(std::span<const unsigned char> bytes, const bclist::options &o) {
+    sha256 hash;
+    hash.update(bytes);
+    // threads and cache_size don't change the output
+    const std::uint64_t params[] = {bclist::serialized_version, bytes.size(), o.max_length, o.lazy};
+    hash.update({reinterpret_cast<const unsigned char *>(params), sizeof(params)});
+    return {bytes.size(), hash.finish()};
+}
+
+fs::path listing_cache::path(const dump_key &key) const {
+    std::string name;
+    for (size_t i = 0; i < 8; i++)
+        fmt::format_to(std::back_inserter(name), "{:02x}", key.digest[i]);
+    return dir / (name + ".bcl");
+}
+
+// an entry is the key followed by the serialized list
+constexpr size_t key_size = sizeof(std::uint64_t) + std::tuple_size_v<decltype(listing_cache::dump_key::digest)>;
+
+bool listing_cache::load(const dump_key &key, bclist &list) const {
+    if (!enabled())
+        return false;
+
+    const fs::path  file = path(key);
+    std::error_code ec;
+    const auto      size = fs::file_size(file, ec);
+    if (ec || size > max_size || size < key_size)
+        return false;
+
+    std::string   data(static_cast<size_t>(size), '\0');
+    std::ifstream in{file, std::ios::binary};
+    if (!in.read(data.data(), static_cast<std::streamsize>(data.size())))
+        return false;
+    in.close();
+
+    // another dump with the same name, store() replaces it
+    dump_key stored{};
+    std::memcpy(&stored.size, data.data(), sizeof(stored.size));
+    std::memcpy(stored.digest.data(), data.data() + sizeof(stored.size), stored.digest.size());
+    if (stored != key)
+        return false;
+
+    if (!list.deserialize(std::string_view{data}.substr(key_size))) {
+        fs::remove(file, ec);
+        return false;
+    }
+    // the modification time orders the entries for eviction
+    fs::last_write_time(file, fs::file_time_type::clock::now(), ec);
+    return true;
+}
+
+bool listing_cache::store(const dump_key &key, const bclist &list) const {
+    if (!enabled() || list.lines.empty())
+        return false;
+
+    std::string data(key_size, '\0');
+    std::memcpy(data.data(), &key.size, sizeof(key.size));
+    std::memcpy(data.data() + sizeof(key.size), key.digest.data(), key.digest.size());
+    data += list.serialize();
+    if (data.size() > max_size) {
+        evict();
+        return false;
+    }
+
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+
+    // written under a unique name and renamed, readers never see a partial entry
+    const fs::path file = path(key);
+    fs::path       temp = file;
+    temp += fmt::format(".{:x}.{:x}.tmp", std::hash<std::thread::id>{}(std::this_thread::get_id()), std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+        std::ofstream out{temp, std::ios::binary};
+        if (!out.write(data.data(), static_cast<std::streamsize>(data.size()))) {
+            out.close();
+            fs::remove(temp, ec);
+            return false;
+        }
+    }
+    fs::rename(temp, file, ec);
+    if (ec) {
+        fs::remove(temp, ec);
+        return false;
+    }
+
+    evict();
+    return true;
+}
+
+void listing_cache::evict() const {
+    struct entry {
+        fs::path           path;
+        std::uintmax_t     size;
+        fs::file_time_type time;
+    };
+    std::vector<entry> entries;
+    std::uintmax_t     total = 0;
+
+    std::error_code ec;
+    for (auto it = fs::directory_iterator{dir, ec}; !ec && it != fs::directory_iterator{}; it.increment(ec)) {
+        if (it->path().extension() != ".bcl")
+            continue;
+        std::error_code file_ec;
+        const auto      size = it->file_size(file_ec);
+        const auto      time = it->last_write_time(file_ec);
+        if (!file_ec) {
+            entries.push_back({it->path(), size, time});
+            total += size;
+        }
+    }
+    if (total <= max_size)
+        return;
+
+    std::sort(entries.begin(), entries.end(), [](const entry &a, const entry &b) {
+        return a.time < b.time;
+    });
+    for (const entry &e: entries) {
+        if (total <= max_size)
+            break;
+        if (fs::remove(e.path, ec))
+            total -= e.size;
+    }
+}
@@ -0,0 +1,66 @@
+// Luad - Disassembler for compiled Lua scripts.
+// https://github.com/imring/Luad
+// Copyright (C) 2021-2023 Vitaliy Vorobets
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef BCLIST_CACHE_H
+#define BCLIST_CACHE_H
+
+#include <span>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+
+#include "bclist.hpp"
+
+// Directory of serialized lists keyed by the dump bytes and the options.
+// Entries above max_size are evicted, the least recently used first.
+class listing_cache {
+public:
+    inline static constexpr std::uintmax_t default_size = 512 * 1024 * 1024;
+
+    // An empty directory disables the cache.
+    explicit listing_cache(std::filesystem::path dir = {}, std::uintmax_t max_size = default_size) : dir{std::move(dir)}, max_size{max_size} {}
+
+    // Cache directory of the user: %LOCALAPPDATA%/bclist, $XDG_CACHE_HOME/bclist or ~/.cache/bclist.
+    static std::filesystem::path default_dir();
+    // Identity of a dump rendered with some options, kept in the header of its entry.
+    struct dump_key {
+        std::uint64_t                 size;   // of the dump
+        std::array<unsigned char, 32> digest; // SHA-256 of the dump and the options
+
+        bool operator==(const dump_key &) const = default;
+    };
+
+    // Key of the dump rendered with the options, only the options changing the output are used.
+    static dump_key key(std::span<const unsigned char> bytes, const bclist::options &o);
+
+    [[nodiscard]] bool enabled() const {
+        return !dir.empty();
+    }
+    // Fill the list from the cache instead of update(), false if there is no entry with the same key.
+    bool load(const dump_key &key, bclist &list) const;
+    // Save the updated list and evict old entries, false on an error.
+    bool store(const dump_key &key, const bclist &list) const;
+
+private:
+    [[nodiscard]] std::filesystem::path path(const dump_key &key) const;
+    void                                evict() const;
+
+    std::filesystem::path dir;
+    std::uintmax_t        max_size;
+};
+
+#endif // BCLIST_CACHE_H
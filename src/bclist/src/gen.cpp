@@ -0,0 +1,150 @@
+// Luad - Disassembler for compiled Lua scripts.
+// https://github.com/imring/Luad
+// Copyright (C) 2021-2023 Vitaliy Vorobets
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <string>
+#include <iostream>
+
+#include <fmt/core.h>
+
+#include <args.hxx>
+
+#include "synthetic.hpp"
+
+// Number of bytes with an optional K, M or G suffix (powers of 1024), 0 if invalid.
+std::uintmax_t parse_size(const std::string &str) {
+    size_t         end   = 0;
+    std::uintmax_t value = 0;
+    try {
+        value = std::stoull(str, &end);
+    } catch (const std::exception &) {
+        return 0;
+    }
+    const std::string suffix = str.substr(end);
+    if (suffix.empty())
+        return value;
+    if (suffix == "K" || suffix == "k")
+        return value << 10;
+    if (suffix == "M" || suffix == "m")
+        return value << 20;
+    if (suffix == "G" || suffix == "g")
+        return value << 30;
+    return 0;
+}
+
+// Number of prototypes giving a dump of about `size` bytes, the prototypes besides the main one have the same shape.
+size_t protos_for_size(dump_shape shape, std::uintmax_t size) {
+    shape.protos               = 2;
+    const std::uintmax_t base  = dump_size(shape);
+    shape.protos               = 3;
+    const std::uintmax_t proto = dump_size(shape) - base;
+    if (size <= base || proto == 0)
+        return size < base ? 1 : 2;
+    return static_cast<size_t>(2 + (size - base) / proto);
+}
+
+int main(int argc, char *argv[]) {
+    const dump_shape defaults;
+
+    args::ArgumentParser         parser{"bclist-gen: Generate a LuaJIT dump of the chosen shape for benchmarks and scaling tests."};
+    args::HelpFlag               h{parser, "help", "Display the help menu", {'h', "help"}};
+    args::ValueFlag<std::string> output{parser, "file", "Output file, - for stdout", {'o', "output"}};
+
+    args::Group                    shape{parser, "Shape of the dump:"};
+    args::ValueFlag<unsigned>      version{shape, "version", "Dump version: 1 - LuaJIT 2.0, 2 - LuaJIT 2.1 (default: 2)", {"bc-version"}, defaults.version};
+    args::ValueFlag<size_t>        protos{shape, "count", "Number of prototypes (default: 8)", {'p', "protos"}, defaults.protos};
+    args::ValueFlag<std::string>   size{shape, "bytes", "Approximate size of the dump with a K, M or G suffix, sets the number of prototypes", {"size"}};
+    args::ValueFlag<size_t>        instructions{shape, "count", "Instructions per prototype (default: 64)", {'n', "instructions"}, defaults.instructions};
+    args::ValueFlag<double>        jumps{shape, "share", "Share of instructions in comparison + JMP pairs, 0..1 (default: 0.125)", {"jumps"}, defaults.jumps};
+    args::ValueFlag<size_t>        table_size{shape, "count", "Entries of the table constant of each prototype, 0 - no table (default: 16)", {"table-size"}, defaults.table_size};
+    args::ValueFlag<size_t>        strings{shape, "count", "String constants per prototype (default: 8)", {"strings"}, defaults.strings};
+    args::ValueFlag<size_t>        string_length{shape, "length", "Length of the long strings (default: 120)", {"string-length"}, defaults.string_length};
+    args::Flag                     strip{shape, "strip", "Don't write the debug info", {"strip"}};
+    args::ValueFlag<std::uint32_t> seed{shape, "seed", "Seed of the generator, the same options give the same dump (default: 1)", {"seed"}, defaults.seed};
+
+    try {
+        parser.ParseCLI(argc, argv);
+    } catch (const args::Completion &e) {
+        std::cout << e.what();
+        return 0;
+    } catch (const args::Help &) {
+        std::cout << parser;
+        return 0;
+    } catch (const args::ParseError &e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    if (!output) {
+        std::cerr << "The output file is required." << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    dump_shape s;
+    s.version       = version.Get();
+    s.protos        = protos.Get();
+    s.instructions  = instructions.Get();
+    s.jumps         = jumps.Get();
+    s.table_size    = table_size.Get();
+    s.strings       = strings.Get();
+    s.string_length = string_length.Get();
+    s.debug         = !strip;
+    s.seed          = seed.Get();
+    if (s.version != 1 && s.version != 2) {
+        fmt::print(stderr, "Unsupported dump version.\n");
+        return 1;
+    }
+    if (s.protos == 0 || s.jumps < 0 || s.jumps > 1) {
+        fmt::print(stderr, "Invalid shape.\n");
+        return 1;
+    }
+    if (size) {
+        const std::uintmax_t bytes = parse_size(size.Get());
+        if (bytes == 0) {
+            fmt::print(stderr, "Invalid size.\n");
+            return 1;
+        }
+        s.protos = protos_for_size(s, bytes);
+    }
+    if (s.protos > max_protos(s)) {
+        fmt::print(stderr, "Too many prototypes or constants, at most {} prototypes fit in the shape.\n", max_protos(s));
+        return 1;
+    }
+
+    const bool to_stdout = output.Get() == "-";
+    std::FILE *out       = to_stdout ? stdout : std::fopen(output.Get().c_str(), "wb");
+    if (!out) {
+        fmt::print(stderr, "Error opening output file.\n");
+        return 1;
+    }
+    std::uintmax_t written = 0;
+    const bool     ok      = generate_dump(s, [&](std::span<const dislua::uchar> bytes) {
+        written += bytes.size();
+        return std::fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size();
+    });
+    if (!to_stdout) {
+        std::fclose(out);
+    }
+    if (!ok) {
+        fmt::print(stderr, "Error writing output file.\n");
+        return 1;
+    }
+    fmt::print(stderr, "Prototypes: {}, instructions: {}, {} bytes\n", s.protos, s.protos * std::max<size_t>(s.instructions, 1), written);
+    return 0;
+}
@@ -15,58 +15,226 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#include <filesystem>
+#include <mutex>
+#include <atomic>
+#include <cstdio>
+#include <chrono>
+#include <ctime>
+#include <thread>
 #include <fstream>
+#include <algorithm>
+#include <filesystem>
 
 #include <fmt/core.h>
-#include <fmt/os.h>
 
 #include <args.hxx>
 
+#include "cache.hpp"
 #include "bclist.hpp"
+#include "mapped_file.hpp"
 
 namespace fs = std::filesystem;
 
-void print_info(std::string_view str, bclist::options o = bclist::options{}) {
-    fs::path filename = str;
+struct stats {
+    size_t files = 0, failed = 0, bytes = 0, protos = 0, instructions = 0;
+
+    stats &operator+=(const stats &s) {
+        files += s.files;
+        failed += s.failed;
+        bytes += s.bytes;
+        protos += s.protos;
+        instructions += s.instructions;
+        return *this;
+    }
+};
+
+// Write the bytecode list of the file (or its NDJSON records), returns an error message (empty on success).
+std::string print_info(const fs::path &path, std::string_view output, bool file_offsets, bool json, bclist::options o, const listing_cache &cache, stats &st, const bclist::progress_callback &progress = {}) {
+    fs::path filename = path;
 
-    if (!fs::is_regular_file(filename)) {
-        fmt::print(stderr, "The path isn't a file.\n");
-        return;
+    std::error_code ec;
+    if (!fs::exists(filename, ec) || fs::is_directory(filename, ec)) {
+        return "The path isn't a file.";
     }
-    std::ifstream luac(filename, std::ios::binary);
-    if (luac.fail()) {
-        fmt::print(stderr, "Error opening file.\n");
-        return;
+    // instruction lines are formatted while writing, their text is never kept in memory;
+    // the rows of all lines and the dump still are
+    o.lazy       = true;
+    o.cache_size = 0;
+
+    listing_cache::dump_key            key{};
+    size_t                             size = 0;
+    std::unique_ptr<dislua::dump_info> info;
+    {
+        // the file is only read by the parser, its mapping and the parser's buffer are released here
+        const mapped_file luac{filename};
+        if (!luac.is_open()) {
+            return "Error opening file.";
+        }
+        const auto bytes = luac.data();
+        key              = listing_cache::key(bytes, o);
+        size             = bytes.size();
+        info             = dislua::read_all(dislua::buffer(bytes.begin(), bytes.end()));
     }
-    dislua::buffer buf((std::istreambuf_iterator<char>(luac)), std::istreambuf_iterator<char>());
-    auto           info = dislua::read_all(buf);
-    luac.close();
     if (!info) {
-        fmt::print(stderr, "Unknown compiler of lua script.\n");
-        return;
+        return "Unknown compiler of lua script.";
     }
 
-    fs::path new_filename = filename.stem();
-    new_filename += fs::path("-bclist.lua");
-    filename.replace_filename(new_filename);
+    st.bytes += size;
+    st.protos += info->protos.size();
+    for (const auto &proto: info->protos) {
+        st.instructions += proto.ins.size();
+    }
+
+    if (output.empty()) {
+        fs::path new_filename = filename.stem();
+        new_filename += fs::path(json ? "-bclist.ndjson" : "-bclist.lua");
+        filename.replace_filename(new_filename);
+    } else {
+        filename = output;
+    }
 
     auto list    = bclist::get_list(*info);
     list->option = o;
-    list->update();
+    info.reset(); // the list has its own copy of the dump
+    // records are written straight from the dump
+    if (!json && !cache.load(key, *list)) {
+        list->progress = progress;
+        list->update();
+        cache.store(key, *list);
+    }
+    // write() only reads the line table, divs repeat the rows of every line
+    list->divs = {};
 
-    auto out = fmt::output_file(filename.string());
-    out.print("{}", list->full());
+    const bool to_stdout = output == "-";
+    std::FILE *out       = to_stdout ? stdout : std::fopen(filename.string().c_str(), "wb");
+    if (!out) {
+        return "Error opening output file.";
+    }
+    const bool written = json ? list->write_json(out) : list->write(out, file_offsets);
+    if (!to_stdout) {
+        std::fclose(out);
+    }
+    return written ? std::string{} : "Error writing output file.";
+}
+
+// Files of the paths, directories are walked recursively and only files with the extension are taken.
+std::vector<fs::path> collect_files(const std::vector<std::string> &paths, std::string_view ext) {
+    std::vector<fs::path> result;
+    const auto            matches = [ext](const fs::path &p) {
+        const std::string name = p.filename().string();
+        return !name.ends_with("-bclist.lua") && !name.ends_with("-bclist.ndjson") && (ext.empty() || p.extension() == ext);
+    };
+
+    for (const std::string &str: paths) {
+        const fs::path  path = str;
+        std::error_code ec;
+        if (!fs::is_directory(path, ec)) {
+            result.emplace_back(path);
+            continue;
+        }
+
+        for (auto it = fs::recursive_directory_iterator{path, fs::directory_options::skip_permission_denied, ec}; !ec && it != fs::recursive_directory_iterator{}; it.increment(ec)) {
+            if (it->is_regular_file(ec) && matches(it->path())) {
+                result.emplace_back(it->path());
+            }
+        }
+        if (ec) {
+            fmt::print(stderr, "{}: {}\n", path.string(), ec.message());
+        }
+    }
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+// Paths from a file, one per line.
+std::vector<std::string> read_list(const fs::path &path) {
+    std::vector<std::string> result;
+    std::ifstream            in{path};
+    if (in.fail()) {
+        fmt::print(stderr, "{}: Error opening file.\n", path.string());
+        return result;
+    }
+    for (std::string line; std::getline(in, line);) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            result.emplace_back(std::move(line));
+        }
+    }
+    return result;
+}
+
+// Process the files on `jobs` threads, each file is rendered in one thread.
+stats process_batch(const std::vector<fs::path> &files, size_t jobs, bool file_offsets, bool json, bclist::options o, const listing_cache &cache) {
+    o.threads = 1;
+    if (jobs == 0) {
+        jobs = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    jobs = std::min(jobs, files.size());
+
+    stats               total;
+    std::mutex          mutex;
+    std::atomic<size_t> next = 0;
+    const auto          worker = [&] {
+        stats local;
+        for (size_t i = next++; i < files.size(); i = next++) {
+            stats       st;
+            std::string error;
+            try {
+                error = print_info(files[i], {}, file_offsets, json, o, cache, st);
+            } catch (const std::exception &e) {
+                error = e.what();
+            }
+
+            local.files++;
+            if (error.empty()) {
+                local += st;
+            } else {
+                local.failed++;
+                std::lock_guard lock{mutex};
+                fmt::print(stderr, "{}: {}\n", files[i].string(), error);
+            }
+        }
+        std::lock_guard lock{mutex};
+        total += local;
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < jobs; i++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &t: pool) {
+        t.join();
+    }
+    return total;
 }
 
 int main(int argc, char *argv[]) {
     args::ArgumentParser         parser{"bclist-cli: Print the bytecode list of the compiled Lua script."};
     args::HelpFlag               h{parser, "help", "Display the help menu", {'h', "help"}};
     args::ValueFlag<std::string> input{parser, "file", "Input file", {'i', "input"}};
+    args::ValueFlag<std::string> output{parser, "file", "Output file, - for stdout (default: <input>-bclist.lua)", {'o', "output"}};
+
+    args::Group                      batch{parser, "Batch mode (each listing is written next to its file):"};
+    args::PositionalList<std::string> paths{batch, "paths", "Files or directories to process"};
+    args::ValueFlag<std::string>     list{batch, "file", "File with the paths to process, one per line", {"list"}};
+    args::ValueFlag<std::string>     ext{batch, "ext", "Extension of files taken from directories, empty for all (default: .luac)", {"ext"}, ".luac"};
+    args::ValueFlag<size_t>          jobs{batch, "count", "Number of files processed at once (0 - all hardware threads)", {"jobs"}, 0};
 
     args::Group             bcoptions{parser, "Options for bclist's output:"};
-    args::ValueFlag<bool>   show_file_offsets{bcoptions, "show", "Show offsets in the script", {"file-offsets"}, false};
+    args::Flag              show_file_offsets{bcoptions, "show", "Show offsets in the script", {"file-offsets"}};
     args::ValueFlag<size_t> max_length{bcoptions, "length", "Maximum line length", {"max-length"}, 0};
+    args::ValueFlag<size_t> threads{bcoptions, "count", "Number of rendering threads (0 - all hardware threads)", {'j', "threads"}, 0};
+    args::Flag              show_progress{bcoptions, "show", "Show the number of rendered prototypes of the input file", {"progress"}};
+    args::Flag              json{bcoptions, "json", "Write one JSON object per prototype, instruction and constant (NDJSON) instead of the list", {"json"}};
+
+    args::Group                  caching{parser, "Cache of rendered lists:"};
+    args::ValueFlag<std::string> cache_dir{caching, "dir", "Cache directory (default: the user's cache directory)", {"cache-dir"}};
+    args::ValueFlag<size_t>      cache_size{caching, "MiB", "Maximum cache size in MiB (default: 512)", {"cache-size"}, 512};
+    args::Flag                   no_cache{caching, "disable", "Don't read or write the cache", {"no-cache"}};
 
     try {
         parser.ParseCLI(argc, argv);
@@ -82,13 +250,57 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    bclist::options o;
+    o.max_length = max_length.Get();
+    o.threads    = threads.Get();
+
+    listing_cache cache;
+    if (!no_cache) {
+        cache = listing_cache{cache_dir ? fs::path{cache_dir.Get()} : listing_cache::default_dir(), std::uintmax_t{cache_size.Get()} * 1024 * 1024};
+    }
+
+    int code = 0;
     if (input) {
-        bclist::options o;
-        // o.show_file_offsets = show_file_offsets.Get();
-        o.max_length = max_length.Get();
+        bclist::progress_callback progress;
+        if (show_progress) {
+            progress = [](size_t done, size_t total) {
+                fmt::print(stderr, "\rPrototypes: {}/{}", done, total);
+                if (done == total) {
+                    fmt::print(stderr, "\n");
+                }
+                return true;
+            };
+        }
+
+        stats             st;
+        const std::string error = print_info(input.Get(), output.Get(), show_file_offsets.Get(), json.Get(), o, cache, st, progress);
+        if (!error.empty()) {
+            fmt::print(stderr, "{}\n", error);
+            code = 1;
+        }
+    }
+
+    if (paths || list) {
+        std::vector<std::string> names = paths.Get();
+        if (list) {
+            std::vector<std::string> listed = read_list(list.Get());
+            names.insert(names.end(), listed.begin(), listed.end());
+        }
+        const std::vector<fs::path> files = collect_files(names, ext.Get());
+
+        const auto         start     = std::chrono::steady_clock::now();
+        const std::clock_t cpu_start = std::clock();
+        const stats        st        = process_batch(files, jobs.Get(), show_file_offsets.Get(), json.Get(), o, cache);
+        const double       cpu       = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+        const double       wall      = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-        print_info(input.Get(), o);
+        fmt::print("Files: {} ({} failed), {} bytes\n", st.files, st.failed, st.bytes);
+        fmt::print("Prototypes: {}, instructions: {}\n", st.protos, st.instructions);
+        fmt::print("Wall time: {:.3f} s, CPU time: {:.3f} s\n", wall, cpu);
+        if (st.failed != 0) {
+            code = 1;
+        }
     }
 
-    return 0;
+    return code;
 }
\ No newline at end of file
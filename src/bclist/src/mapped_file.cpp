@@ -0,0 +1,115 @@
+// Luad - Disassembler for compiled Lua scripts.
+// https://github.com/imring/Luad
+// Copyright (C) 2021-2023 Vitaliy Vorobets
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "mapped_file.hpp"
+
+#include <cerrno>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+mapped_file::mapped_file(const std::filesystem::path &path) {
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    LARGE_INTEGER size{};
+    if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        if (HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr)) {
+            view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping); // the view keeps the mapping alive
+        }
+    }
+
+    if (view) {
+        length = static_cast<size_t>(size.QuadPart);
+        opened = true;
+    } else {
+        opened = read(file);
+    }
+    CloseHandle(file);
+}
+
+bool mapped_file::read(void *file) {
+    unsigned char chunk[64 * 1024];
+    DWORD         count = 0;
+    while (ReadFile(file, chunk, sizeof(chunk), &count, nullptr)) {
+        if (count == 0)
+            return true;
+        fallback.insert(fallback.end(), chunk, chunk + count);
+    }
+    return GetLastError() == ERROR_BROKEN_PIPE; // the writer of a pipe closed it
+}
+
+mapped_file::~mapped_file() {
+    if (view)
+        UnmapViewOfFile(view);
+}
+#else
+mapped_file::mapped_file(const std::filesystem::path &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        const auto size = static_cast<size_t>(st.st_size);
+        void      *ptr  = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr != MAP_FAILED) {
+            madvise(ptr, size, MADV_SEQUENTIAL);
+            view   = ptr;
+            length = size;
+        }
+    }
+
+    opened = view != nullptr || read(fd);
+    ::close(fd);
+}
+
+bool mapped_file::read(int fd) {
+    unsigned char chunk[64 * 1024];
+    for (;;) {
+        const ssize_t count = ::read(fd, chunk, sizeof(chunk));
+        if (count == 0)
+            return true;
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        fallback.insert(fallback.end(), chunk, chunk + count);
+    }
+}
+
+mapped_file::~mapped_file() {
+    if (view)
+        munmap(const_cast<void *>(view), length);
+}
+#endif
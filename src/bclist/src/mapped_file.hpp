@@ -0,0 +1,62 @@
+// Luad - Disassembler for compiled Lua scripts.
+// https://github.com/imring/Luad
+// Copyright (C) 2021-2023 Vitaliy Vorobets
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef BCLIST_MAPPED_FILE_H
+#define BCLIST_MAPPED_FILE_H
+
+#include <span>
+#include <vector>
+#include <filesystem>
+
+// Read-only contents of a file. Regular files are mapped into memory,
+// others (pipes, character devices) are read into a buffer.
+class mapped_file {
+public:
+    explicit mapped_file(const std::filesystem::path &path);
+    ~mapped_file();
+
+    mapped_file(const mapped_file &)            = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    [[nodiscard]] bool is_open() const {
+        return opened;
+    }
+    [[nodiscard]] bool is_mapped() const {
+        return view != nullptr;
+    }
+    [[nodiscard]] std::span<const unsigned char> data() const {
+        if (view)
+            return {static_cast<const unsigned char *>(view), length};
+        return fallback;
+    }
+
+private:
+    // Read the rest of the opened file into fallback, it stays open so a pipe keeps its reader.
+#ifdef _WIN32
+    bool read(void *file);
+#else
+    bool read(int fd);
+#endif
+
+    bool                       opened = false;
+    const void                *view   = nullptr;
+    size_t                     length = 0;
+    std::vector<unsigned char> fallback;
+};
+
+#endif // BCLIST_MAPPED_FILE_H
\ No newline at end of file
@@ -0,0 +1,312 @@
+// Luad - Disassembler for compiled Lua scripts.
+// https://github.com/imring/Luad
+// Copyright (C) 2021-2023 Vitaliy Vorobets
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "synthetic.hpp"
+
+#include <random>
+#include <string>
+#include <algorithm>
+
+#include <fmt/format.h>
+
+namespace lj = dislua::lj;
+
+namespace {
+// distance of a jump, D of JMP is a 16-bit biased offset
+constexpr size_t max_jump = 0x7000;
+
+size_t uleb128_size(dislua::uleb128 val) {
+    size_t size = 1;
+    for (; val >= 0x80; val >>= 7)
+        size++;
+    return size;
+}
+
+dislua::uchar opcode(dislua::uint version, std::string_view name) {
+    const auto         *opcodes = version == 1 ? lj::v1::opcodes : lj::v2::opcodes;
+    const dislua::uchar max     = version == 1 ? dislua::uchar{lj::v1::bcops::BCMAX} : dislua::uchar{lj::v2::bcops::BCMAX};
+    for (dislua::uchar i = 0; i < max; i++) {
+        if (opcodes[i].first == name)
+            return i;
+    }
+    return 0;
+}
+
+struct opcodes {
+    dislua::uchar kstr, knum, tdup, uget, addvv, kpri, islt, jmp, fnew, ret0;
+
+    explicit opcodes(dislua::uint v)
+        : kstr{opcode(v, "KSTR")}, knum{opcode(v, "KNUM")}, tdup{opcode(v, "TDUP")}, uget{opcode(v, "UGET")}, addvv{opcode(v, "ADDVV")},
+          kpri{opcode(v, "KPRI")}, islt{opcode(v, "ISLT")}, jmp{opcode(v, "JMP")}, fnew{opcode(v, "FNEW")}, ret0{opcode(v, "RET0")} {}
+};
+
+// the parts of the distributions in <random> differ between standard libraries, only the engine is portable
+size_t below(std::mt19937 &rng, size_t n) {
+    return static_cast<size_t>(rng() % n);
+}
+bool chance(std::mt19937 &rng, double p) {
+    return static_cast<double>(rng()) < p * 4294967296.0;
+}
+
+std::string random_word(std::mt19937 &rng, size_t length) {
+    constexpr std::string_view letters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_ ";
+    std::string                res(length, ' ');
+    for (char &c: res)
+        c = letters[below(rng, letters.size())];
+    return res;
+}
+
+dislua::uleb128 dump_flags(const dump_shape &shape) {
+    return shape.debug ? 0 : dislua::uleb128{lj::dump_flags::strip};
+}
+
+void header(lj::parser &info, const dump_shape &shape) {
+    info.version           = shape.version;
+    info.header.flags      = dump_flags(shape);
+    info.header.debug_name = shape.debug ? "synthetic.lua" : "";
+}
+
+size_t header_size(const dump_shape &shape) {
+    size_t res = 3 + 1 + uleb128_size(dump_flags(shape)); // signature, version, flags
+    if (shape.debug)
+        res += uleb128_size(13) + 13; // "synthetic.lua"
+    return res;
+}
+
+// Constants of a prototype besides its children.
+size_t other_constants(const dump_shape &shape) {
+    return (shape.table_size != 0 ? 1 : 0) + shape.strings;
+}
+
+// D of FNEW and KSTR is 16-bit and counts the constants from the end.
+size_t max_children(const dump_shape &shape) {
+    return 0xFFFF - std::min<size_t>(other_constants(shape), 0xFFFF);
+}
+
+// Children of prototype k, the last loaded one first as the reader pops them.
+// Up to max_children() prototypes are the children of the main function. More are split into groups of
+// max_children() prototypes followed by their parent, the parents are the children of the main function.
+std::vector<size_t> child_ids(const dump_shape &shape, size_t k) {
+    const size_t rest = shape.protos - 1, max = max_children(shape);
+
+    std::vector<size_t> res;
+    if (rest <= max) {
+        if (k == rest) {
+            for (size_t i = k; i-- > 0;)
+                res.push_back(i);
+        }
+        return res;
+    }
+    const size_t group = max + 1;
+    if (k == rest) {
+        for (size_t first = (rest - 1) / group * group;; first -= group) {
+            res.push_back(std::min(first + group, rest) - 1);
+            if (first == 0)
+                break;
+        }
+        return res;
+    }
+    const size_t first = k / group * group;
+    if (k + 1 == std::min(first + group, rest)) {
+        for (size_t i = k; i-- > first;)
+            res.push_back(i);
+    }
+    return res;
+}
+
+// Prototype k, its content depends only on the shape and k.
+dislua::proto make_proto(const dump_shape &shape, const opcodes &op, size_t k, dislua::uleb128 firstline) {
+    std::seed_seq seq{shape.seed, static_cast<std::uint32_t>(k), static_cast<std::uint32_t>(static_cast<std::uint64_t>(k) >> 32)};
+    std::mt19937  rng{seq};
+
+    const bool                main     = k + 1 == shape.protos;
+    const std::vector<size_t> kids     = child_ids(shape, k);
+    const size_t              children = kids.size();
+    const size_t              count    = std::max<size_t>(shape.instructions, 1);
+
+    dislua::proto pr{};
+    pr.flags     = main ? lj::proto_flags::varargs : 0;
+    pr.numparams = main ? 0 : 2;
+    pr.framesize = 8;
+    if (children != 0)
+        pr.flags |= lj::proto_flags::child;
+    if (!main)
+        pr.uv = {0xC000, 0xC001}; // immutable locals 0 and 1 of the main function
+    pr.knum = {0.5, 1e10, -3.25, static_cast<double>(k)};
+
+    // kgc: the children (the last loaded one first), the table, the strings
+    for (size_t id: kids)
+        pr.kgc.emplace_back(dislua::proto_id{id});
+    const size_t table = pr.kgc.size();
+    if (shape.table_size != 0) {
+        dislua::table_t tab;
+        const size_t    array = shape.table_size / 2;
+        for (size_t i = 0; i < array; i++)
+            tab[static_cast<dislua::leb128>(i + 1)] = i % 2 ? dislua::table_val_t{static_cast<double>(i) + 0.5} : dislua::table_val_t{fmt::format("item {}", i)};
+        for (size_t i = array; i < shape.table_size; i++)
+            tab[fmt::format("key_{}", i)] = i % 3 ? dislua::table_val_t{static_cast<double>(rng() % 1000) * 0.25} : dislua::table_val_t{i % 2 == 0};
+        pr.kgc.emplace_back(std::move(tab));
+    }
+    const size_t first_string = pr.kgc.size();
+    for (size_t i = 0; i < shape.strings; i++) {
+        switch (i % 4) {
+        case 0: pr.kgc.emplace_back(fmt::format("name_{}_{}", k, i)); break;
+        case 1: pr.kgc.emplace_back("quoted \"text\"\twith\nescapes"); break;
+        case 2: pr.kgc.emplace_back(random_word(rng, shape.string_length)); break;
+        case 3: pr.kgc.emplace_back("\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82"); break; // UTF-8
+        }
+    }
+    // D of a kgc operand counts from the end
+    const auto gc = [&](size_t i) {
+        return static_cast<dislua::ushort>(pr.kgc.size() - 1 - i);
+    };
+
+    // a pair takes two slots
+    const double pairs = shape.jumps / (2 - shape.jumps);
+
+    pr.ins.resize(count);
+    for (size_t i = 0; i + 1 < count; i++) {
+        dislua::instruction &in = pr.ins[i];
+        in.a                    = static_cast<dislua::uchar>(i % pr.framesize);
+        if (i < children) {
+            in.opcode = op.fnew;
+            in.d      = gc(i);
+            continue;
+        }
+        if (i + 2 < count && chance(rng, pairs)) {
+            in.opcode = op.islt;
+            in.d      = static_cast<dislua::ushort>((i + 1) % pr.framesize);
+
+            // JMP to anywhere in the prototype within its range
+            const size_t from   = i + 2;
+            const size_t low    = from > max_jump ? from - max_jump : 0;
+            const size_t target = low + below(rng, std::min(count, from + max_jump) - low);
+
+            dislua::instruction &jmp = pr.ins[++i];
+            jmp.opcode               = op.jmp;
+            jmp.a                    = static_cast<dislua::uchar>(pr.framesize);
+            jmp.d                    = static_cast<dislua::ushort>(0x8000 + target - from);
+            continue;
+        }
+        switch (below(rng, 6)) {
+        case 0:
+            if (shape.strings != 0) {
+                in.opcode = op.kstr;
+                in.d      = gc(first_string + below(rng, shape.strings));
+                break;
+            }
+            [[fallthrough]];
+        case 1:
+            in.opcode = op.knum;
+            in.d      = static_cast<dislua::ushort>(below(rng, pr.knum.size()));
+            break;
+        case 2:
+            if (shape.table_size != 0) {
+                in.opcode = op.tdup;
+                in.d      = gc(table);
+                break;
+            }
+            [[fallthrough]];
+        case 3:
+            if (!pr.uv.empty()) {
+                in.opcode = op.uget;
+                in.d      = static_cast<dislua::ushort>(below(rng, pr.uv.size()));
+                break;
+            }
+            [[fallthrough]];
+        case 4:
+            in.opcode = op.addvv;
+            in.b      = static_cast<dislua::uchar>(below(rng, pr.framesize));
+            in.c      = static_cast<dislua::uchar>(below(rng, pr.framesize));
+            break;
+        default:
+            in.opcode = op.kpri;
+            in.d      = static_cast<dislua::ushort>(below(rng, 3));
+            break;
+        }
+    }
+    pr.ins.back().opcode = op.ret0;
+    pr.ins.back().d      = 1;
+
+    if (shape.debug) {
+        pr.firstline = firstline;
+        pr.numline   = static_cast<dislua::uleb128>(count / 4 + 1);
+        for (size_t i = 0; i < count; i++)
+            pr.lineinfo.push_back(static_cast<dislua::uint>(i / 4));
+        if (!main)
+            pr.uv_names = {"self", "env"};
+    }
+    return pr;
+}
+} // namespace
+
+size_t max_protos(const dump_shape &shape) {
+    if (other_constants(shape) > 0xFFFF)
+        return 0;
+    const size_t max = max_children(shape);
+    return 1 + max * (max + 1);
+}
+
+bool generate_dump(const dump_shape &shape, const dump_sink &sink, size_t chunk) {
+    if (shape.protos == 0 || shape.protos > max_protos(shape))
+        return false;
+    const opcodes op{shape.version};
+    chunk = std::max<size_t>(chunk, 1);
+
+    // the writer puts the header before and the end mark after the prototypes, each part keeps only its prototypes
+    lj::parser empty;
+    header(empty, shape);
+    empty.write();
+    const std::vector<dislua::uchar> frame  = empty.buf.copy_data();
+    const size_t                     prefix = std::min(header_size(shape), frame.size());
+    const size_t                     suffix = frame.size() - prefix;
+    if (!sink({frame.data(), prefix}))
+        return false;
+
+    dislua::uleb128 line = 1;
+    for (size_t first = 0; first < shape.protos; first += chunk) {
+        lj::parser part;
+        header(part, shape);
+        for (size_t k = first; k < std::min(shape.protos, first + chunk); k++) {
+            part.protos.push_back(make_proto(shape, op, k, line));
+            line += part.protos.back().numline;
+        }
+        part.write();
+        const std::vector<dislua::uchar> bytes = part.buf.copy_data();
+        if (!sink({bytes.data() + prefix, bytes.size() - prefix - suffix}))
+            return false;
+    }
+    return sink({frame.data() + prefix, suffix});
+}
+
+std::vector<dislua::uchar> make_dump(const dump_shape &shape) {
+    std::vector<dislua::uchar> res;
+    generate_dump(shape, [&](std::span<const dislua::uchar> bytes) {
+        res.insert(res.end(), bytes.begin(), bytes.end());
+        return true;
+    });
+    return res;
+}
+
+std::uintmax_t dump_size(const dump_shape &shape) {
+    std::uintmax_t res = 0;
+    generate_dump(shape, [&](std::span<const dislua::uchar> bytes) {
+        res += bytes.size();
+        return true;
+    });
+    return res;
+}
@@ -0,0 +1,56 @@
+// Luad - Disassembler for compiled Lua scripts.
+// https://github.com/imring/Luad
+// Copyright (C) 2021-2023 Vitaliy Vorobets
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef BCLIST_SYNTHETIC_H
+#define BCLIST_SYNTHETIC_H
+
+#include <span>
+#include <cstdio>
+#include <cstdint>
+#include <functional>
+
+#include "dislua/dislua.hpp"
+
+// Shape of a generated LuaJIT dump. The last prototype is the main function, the others are its children,
+// or the children of intermediate prototypes if the main function can't refer to all of them (see max_protos()).
+// The same shape and seed always give the same bytes.
+struct dump_shape {
+    dislua::uint  version       = 2;     // 1 - LuaJIT 2.0, 2 - LuaJIT 2.1
+    size_t        protos        = 8;
+    size_t        instructions  = 64;    // per prototype
+    double        jumps         = 0.125; // share of instructions in comparison + JMP pairs
+    size_t        table_size    = 16;    // entries of the table constant of each prototype, 0 - no table
+    size_t        strings       = 8;     // string constants per prototype
+    size_t        string_length = 120;   // length of the long ones
+    bool          debug         = true;  // line info and upvalue names
+    std::uint32_t seed          = 1;
+};
+
+// Called with consecutive parts of the dump, returning false stops the generation.
+using dump_sink = std::function<bool(std::span<const dislua::uchar> bytes)>;
+
+// Largest number of prototypes of the shape, 0 if its constants don't fit in 16-bit operands.
+size_t max_protos(const dump_shape &shape);
+// Build the dump with dislua's writer, at most `chunk` prototypes are kept in memory at once.
+// Returns false if the sink stopped it or the shape has no prototypes or more than max_protos().
+bool generate_dump(const dump_shape &shape, const dump_sink &sink, size_t chunk = 1024);
+// Whole dump in memory.
+std::vector<dislua::uchar> make_dump(const dump_shape &shape);
+// Size of the dump, computed by generating it.
+std::uintmax_t dump_size(const dump_shape &shape);
+
+#endif // BCLIST_SYNTHETIC_H
@@ -0,0 +1,113 @@
+// Luad - Disassembler for compiled Lua scripts.
+// https://github.com/imring/Luad
+// Copyright (C) 2021-2023 Vitaliy Vorobets
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+// bclist-synthetic-test: dumps of make_dump() are read back by dislua as the prototypes of their shape
+// and written back to the same bytes.
+
+#include <string>
+#include <variant>
+#include <string_view>
+
+#include <fmt/core.h>
+
+#include "synthetic.hpp"
+
+namespace {
+dislua::uchar fnew_opcode(dislua::uint version) {
+    const auto         *opcodes = version == 1 ? dislua::lj::v1::opcodes : dislua::lj::v2::opcodes;
+    const dislua::uchar max     = version == 1 ? dislua::uchar{dislua::lj::v1::bcops::BCMAX} : dislua::uchar{dislua::lj::v2::bcops::BCMAX};
+    for (dislua::uchar i = 0; i < max; i++) {
+        if (opcodes[i].first == "FNEW")
+            return i;
+    }
+    return 0;
+}
+
+bool check(std::string_view name, const dump_shape &shape) {
+    const auto fail = [&](const std::string &what) {
+        fmt::print(stderr, "{}: {}\n", name, what);
+        return false;
+    };
+
+    const std::vector<dislua::uchar> bytes = make_dump(shape);
+    const auto                       info  = dislua::read_all(dislua::buffer(bytes.begin(), bytes.end()));
+    if (!info || info->compiler() != dislua::compilers::luajit)
+        return fail("not read as a LuaJIT dump");
+    if (info->version != shape.version)
+        return fail(fmt::format("version {} instead of {}", info->version, shape.version));
+    if (info->protos.size() != shape.protos)
+        return fail(fmt::format("{} prototypes instead of {}", info->protos.size(), shape.protos));
+
+    // FNEW refers to a child loaded before its prototype
+    const dislua::uchar fnew = fnew_opcode(shape.version);
+    for (size_t k = 0; k < info->protos.size(); k++) {
+        const dislua::proto &pr = info->protos[k];
+        for (const dislua::instruction &in: pr.ins) {
+            if (in.opcode != fnew)
+                continue;
+            if (in.d >= pr.kgc.size())
+                return fail(fmt::format("FNEW {} out of the constants of prototype {}", in.d, k));
+            const auto *child = std::get_if<dislua::proto_id>(&pr.kgc[pr.kgc.size() - 1 - in.d]);
+            if (!child || child->id >= k)
+                return fail(fmt::format("FNEW {} of prototype {} isn't a child", in.d, k));
+        }
+    }
+
+    info->write();
+    if (info->buf.copy_data() != bytes)
+        return fail("written back to other bytes");
+    return true;
+}
+} // namespace
+
+int main() {
+    bool ok = true;
+
+    dump_shape shape;
+    ok &= check("default", shape);
+
+    shape.version = 1;
+    ok &= check("version 1", shape);
+
+    shape         = {};
+    shape.debug   = false;
+    shape.protos  = 100;
+    shape.strings = 0;
+    ok &= check("stripped", shape);
+
+    // more children than a 16-bit FNEW operand can refer to, they get intermediate parents
+    shape              = {};
+    shape.protos       = 70000;
+    shape.instructions = 2;
+    shape.jumps        = 0;
+    shape.table_size   = 0;
+    shape.strings      = 0;
+    shape.debug        = false;
+    ok &= check("intermediate parents", shape);
+
+    shape         = {};
+    shape.strings = 0x10000;
+    if (generate_dump(shape, [](std::span<const dislua::uchar>) { return true; })) {
+        fmt::print(stderr, "too many constants: generated\n");
+        ok = false;
+    }
+
+    if (ok)
+        fmt::print("all dumps read back\n");
+    return ok ? 0 : 1;
+}
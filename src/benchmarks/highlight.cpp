@@ -0,0 +1,130 @@
+// Luad - Disassembler for compiled Lua scripts.
+// https://github.com/imring/Luad
+// Copyright (C) 2021-2023 Vitaliy Vorobets
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Cost of highlighting a line of the listing: the single-pass SyntaxHighlighter
+// against the regular expressions it replaced.
+
+#include <cstdio>
+#include <algorithm>
+
+#include <QElapsedTimer>
+#include <QRegularExpression>
+
+#include "../syntaxhighlighter.hpp"
+
+// previous implementation, kept for comparison
+class RegexHighlighter {
+public:
+    RegexHighlighter() {
+        QTextCharFormat keyword;
+        keyword.setForeground(Qt::darkBlue);
+        keyword.setFontWeight(QFont::Bold);
+        for (const char *word: {"do", "end", "true", "false", "nil", "invalid"}) {
+            rules.append({QRegularExpression(QStringLiteral("\\b%1\\b").arg(word)), keyword});
+        }
+
+        QTextCharFormat number;
+        number.setForeground(Qt::darkGreen);
+        rules.append({QRegularExpression(QStringLiteral("\\b(\\+\\-){0,1}\\d+(\\.\\d+){0,1}\\b")), number});
+        rules.append({QRegularExpression(QStringLiteral("\\b(\\+\\-){0,1}(0b)?[01]+\\b")), number});
+        rules.append({QRegularExpression(QStringLiteral("\\b(\\+\\-){0,1}(0x)?[0-9A-Fa-f]+\\b")), number});
+
+        QTextCharFormat quotation;
+        quotation.setForeground(Qt::darkCyan);
+        rules.append({QRegularExpression(QStringLiteral("\".*\"")), quotation});
+
+        QTextCharFormat comment;
+        comment.setForeground(Qt::gray);
+        rules.append({QRegularExpression(QStringLiteral("\\-\\-[^\n]*")), comment});
+    }
+
+    QList<QTextLayout::FormatRange> highlight(const QString &text) const {
+        QVector<const QTextCharFormat *> formats(text.size(), nullptr);
+        for (const Rule &rule: rules) {
+            QRegularExpressionMatchIterator it = rule.pattern.globalMatch(text);
+            while (it.hasNext()) {
+                const QRegularExpressionMatch match = it.next();
+                std::fill_n(formats.begin() + match.capturedStart(), match.capturedLength(), &rule.format);
+            }
+        }
+
+        QList<QTextLayout::FormatRange> result;
+        for (qsizetype i = 0; i < formats.size();) {
+            qsizetype j = i + 1;
+            while (j < formats.size() && formats[j] == formats[i]) {
+                ++j;
+            }
+            if (formats[i]) {
+                result.append({static_cast<int>(i), static_cast<int>(j - i), *formats[i]});
+            }
+            i = j;
+        }
+        return result;
+    }
+
+private:
+    struct Rule {
+        QRegularExpression pattern;
+        QTextCharFormat    format;
+    };
+    QList<Rule> rules;
+};
+
+volatile qint64 sink; // keeps the results from being optimized out
+
+// nanoseconds per call, repeated for at least 200 ms
+template <typename Highlighter>
+double measure(const Highlighter &highlighter, const QString &line) {
+    QElapsedTimer timer;
+    qint64        calls = 0, formats = 0;
+    timer.start();
+    do {
+        for (int i = 0; i < 100; i++) {
+            formats += highlighter.highlight(line).size();
+        }
+        calls += 100;
+    } while (timer.elapsed() < 200);
+    sink = formats;
+    return static_cast<double>(timer.nsecsElapsed()) / static_cast<double>(calls);
+}
+
+int main() {
+    QString table = "\tkgc_0_1 = {";
+    for (int i = 1; i <= 60; i++) {
+        table += QStringLiteral("[%1] = \"value %1\", [\"key_%1\"] = %2, ").arg(i).arg(i * 0.25);
+    }
+    table += "[\"flag\"] = true}";
+
+    const std::pair<const char *, QString> lines[] = {
+        {"instruction", "\t(07 01 00 00) TDUP\t1, kgc_0_1 (0)"},
+        {"jump", "\t(0B 01 00 00) UCLO\t1, label_0_4 (-2) -- Line in source code: 12"},
+        {"label", "\tlabel_0_4:"},
+        {"info", "\tflags = 0b00000011 -- PROTO_CHILD | PROTO_VARARG"},
+        {"string", "\tkgc_0_0 = \"hello \\\"world\\\"\\n\""},
+        {"table", table},
+    };
+
+    const RegexHighlighter  regex;
+    const SyntaxHighlighter lexer;
+    std::printf("%-12s %8s %12s %12s %8s\n", "line", "chars", "regex, ns", "lexer, ns", "speedup");
+    for (const auto &[name, line]: lines) {
+        const double before = measure(regex, line);
+        const double after  = measure(lexer, line);
+        std::printf("%-12s %8lld %12.0f %12.0f %7.1fx\n", name, static_cast<long long>(line.size()), before, after, before / after);
+    }
+    return 0;
+}
\ No newline at end of file
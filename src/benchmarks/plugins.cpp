@@ -0,0 +1,118 @@
+// Luad - Disassembler for compiled Lua scripts.
+// https://github.com/imring/Luad
+// Copyright (C) 2021-2023 Vitaliy Vorobets
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Cost of reading prototype vectors from a plugin: the container views of the
+// dislua bindings against the tables they replaced, which were built on every call.
+
+#include <cstdio>
+
+#include <QElapsedTimer>
+
+#include "../plugins/customfuncs.hpp"
+
+// previous bindings, kept for comparison
+struct kgc_copy {
+    dislua::kgc_t value;
+};
+
+void initialize_copying_types(sol::state &lua) {
+    lua.new_usertype<kgc_copy>("kgc", sol::call_constructor, sol::no_constructor);
+
+    lua.new_usertype<dislua::instruction>("instruction",
+        sol::call_constructor, sol::no_constructor,
+        "opcode", &dislua::instruction::opcode,
+        "a", &dislua::instruction::a,
+        "d", &dislua::instruction::d
+    );
+
+    lua.new_usertype<dislua::proto>("proto",
+        sol::call_constructor, sol::no_constructor,
+        "instructions", [](dislua::proto &p) { return sol::as_table(p.ins); },
+        "kgc_values", [&lua](dislua::proto &p) {
+            sol::table result = lua.create_table();
+            for (std::size_t i = 0; i < p.kgc.size(); i++) {
+                result[i + 1] = kgc_copy{p.kgc[i]};
+            }
+            return result;
+        },
+        "knum_values", [](dislua::proto &p) { return sol::as_table(p.knum); }
+    );
+}
+
+// the field checks of plugins/invalid_opcodes.lua
+constexpr const char *script = R"(
+function check(proto)
+    local invalid = 0
+    local instructions = proto:instructions()
+    for i = 1, #instructions do
+        local ins = instructions[i]
+        if ins.d > #proto:kgc_values() or ins.a > #proto:knum_values() then
+            invalid = invalid + 1
+        end
+    end
+    return invalid
+end
+)";
+
+// nanoseconds per instruction, repeated for at least 200 ms
+template <typename T>
+double measure(sol::state &lua, T proto, std::size_t count) {
+    lua.script(script);
+    sol::protected_function check = lua["check"];
+
+    QElapsedTimer timer;
+    qint64        calls = 0;
+    timer.start();
+    do {
+        const sol::protected_function_result result = check(proto);
+        if (!result.valid()) {
+            const sol::error err = result;
+            std::fprintf(stderr, "%s\n", err.what());
+            return 0;
+        }
+        calls++;
+    } while (timer.elapsed() < 200);
+    return static_cast<double>(timer.nsecsElapsed()) / static_cast<double>(calls * static_cast<qint64>(count));
+}
+
+int main() {
+    std::printf("%-14s %8s %14s %12s %8s\n", "instructions", "kgc", "tables, ns", "views, ns", "speedup");
+    for (const std::size_t count: {100, 1000, 10000}) {
+        const auto     shared = std::make_shared<dislua::proto>();
+        dislua::proto &proto  = *shared;
+        proto.ins.resize(count);
+        for (std::size_t i = 0; i < count; i++) {
+            proto.ins[i].a = static_cast<decltype(proto.ins[i].a)>(i % 8);
+            proto.ins[i].d = static_cast<decltype(proto.ins[i].d)>(i % 64);
+        }
+        proto.kgc.assign(count / 4, std::string{"constant"});
+        proto.knum.assign(count / 8, 0.5);
+
+        sol::state copying;
+        copying.open_libraries(sol::lib::base);
+        initialize_copying_types(copying);
+
+        sol::state views;
+        views.open_libraries(sol::lib::base);
+        LuaCustom::initialize_dislua_types(views);
+
+        const double before = measure(copying, &proto, count);
+        const double after  = measure(views, proto_ref{shared}, count);
+        std::printf("%-14zu %8zu %14.0f %12.0f %7.1fx\n", count, proto.kgc.size(), before, after, before / after);
+    }
+    return 0;
+}
\ No newline at end of file
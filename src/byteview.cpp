@@ -0,0 +1,62 @@
+// Luad - Disassembler for compiled Lua scripts.
+// https://github.com/imring/Luad
+// Copyright (C) 2021-2023 Vitaliy Vorobets
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "byteview.hpp"
+
+#include <cstring>
+
+ByteView::ByteView(std::weak_ptr<File> file, QObject *parent) : QIODevice{parent}, file{file} {}
+
+bool ByteView::open(OpenMode mode) {
+    if (mode & QIODevice::WriteOnly) {
+        return false;
+    }
+    // reads go straight to the file bytes without the buffer of QIODevice
+    return QIODevice::open(mode | QIODevice::Unbuffered);
+}
+
+bool ByteView::isSequential() const {
+    return false;
+}
+
+qint64 ByteView::size() const {
+    return static_cast<qint64>(bytes().size());
+}
+
+qint64 ByteView::readData(char *data, qint64 maxSize) {
+    const std::span<const uchar> view = bytes();
+    const qint64                 p    = pos();
+    if (p >= static_cast<qint64>(view.size())) {
+        return 0;
+    }
+
+    const qint64 count = qMin(maxSize, static_cast<qint64>(view.size()) - p);
+    std::memcpy(data, view.data() + p, static_cast<std::size_t>(count));
+    return count;
+}
+
+qint64 ByteView::writeData(const char * /* data */, qint64 /* maxSize */) {
+    return -1;
+}
+
+std::span<const uchar> ByteView::bytes() const {
+    if (auto ptr = file.lock()) {
+        return ptr->bytes();
+    }
+    return {};
+}
\ No newline at end of file
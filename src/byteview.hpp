@@ -15,15 +15,33 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#ifndef LUAD_UTILS_HPP
-#define LUAD_UTILS_HPP
 
-#include <vector>
+#ifndef LUAD_BYTEVIEW_HPP
+#define LUAD_BYTEVIEW_HPP
 
-#include "bclist.hpp"
+#include <QIODevice>
 
-namespace utils {
-std::size_t line_by_addr(const std::vector<bclist::div::line> &lines, std::size_t addr, bool last = false);
-} // namespace utils
+#include "file.hpp"
 
-#endif // LUAD_UTILS_HPP
\ No newline at end of file
+// Read-only device over the bytes of the opened file, nothing is copied.
+class ByteView : public QIODevice {
+    Q_OBJECT
+
+public:
+    ByteView(std::weak_ptr<File> file, QObject *parent = nullptr);
+
+    bool   open(OpenMode mode) override;
+    bool   isSequential() const override;
+    qint64 size() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    std::span<const uchar> bytes() const;
+
+    std::weak_ptr<File> file;
+};
+
+#endif // LUAD_BYTEVIEW_HPP
\ No newline at end of file
@@ -15,23 +15,44 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+
 #include "disassembler.hpp"
 
+#include <limits>
+#include <algorithm>
+
 #include <QMenu>
 #include <QPainter>
+#include <QKeyEvent>
 #include <QClipboard>
-#include <QTextBlock>
-#include <QTextCursor>
+#include <QtMath>
+#include <QScrollBar>
+#include <QTextLayout>
 #include <QGuiApplication>
-#include <QTextDocumentFragment>
 
-#include "utils.hpp"
 #include "xrefmenu.hpp"
 
+namespace {
+constexpr int         textMargin  = 4;
+constexpr qreal       tabDistance = 40;
+constexpr QLatin1Char tabChar{'\t'};
+
+bool isWordChar(QChar c) {
+    return c.isLetterOrNumber() || c == QLatin1Char('_');
+}
+
+bool isAscii(QStringView text) {
+    return std::all_of(text.begin(), text.end(), [](QChar c) {
+        return c.unicode() < 0x80;
+    });
+}
+} // namespace
+
 Disassembler::Disassembler(QWidget *parent, std::weak_ptr<File> file)
-    : QPlainTextEdit{parent}, file{file}, lineNumberArea{new LineNumberArea{this}}, syntaxHighlighter{new SyntaxHighlighter{document()}},
-      contextMenu{new QMenu{"Context menu", this}}, lineHighlighter{} {
+    : QAbstractScrollArea{parent}, lineNumberArea{new LineNumberArea{this}}, lineHighlighter{}, contextMenu{new QMenu{"Context menu", this}}, file{file} {
     setContextMenuPolicy(Qt::CustomContextMenu);
+    setFocusPolicy(Qt::StrongFocus);
+    viewport()->setCursor(Qt::IBeamCursor);
 
     QFont fontText;
     fontText.setFamily("Courier New");
@@ -40,41 +61,24 @@ Disassembler::Disassembler(QWidget *parent, std::weak_ptr<File> file)
     setFont(fontText);
 
     if (auto ptr = file.lock()) {
-        bclist::div &&only_lines = ptr->dump_info->divs.only_lines();
-        lines                    = only_lines.lines;
-        setPlainText(QString::fromStdString(only_lines.string()));
-
-        for (auto &line: lines) {
-            if (!line.key.empty()) {
-                addrKeys.emplace(line.key, line.from);
-            }
-        }
+        list  = ptr->dump_info.get();
+        lines = &list->lines;
     }
 
-    updateLineNumberAreaWidth(0);
-    highlightCurrentLine();
-
-    setReadOnly(true);
-    setTextInteractionFlags(Qt::TextSelectableByMouse | Qt::TextSelectableByKeyboard);
-    setLineWrapMode(QPlainTextEdit::NoWrap);
-
-    setTabStopDistance(40);
-    // setTabStopDistance(fontMetrics().horizontalAdvance(QLatin1Char(' ')) * tabsize);
+    setViewportMargins(lineNumberAreaWidth(), 0, 0, 0);
+    updateScrollBars();
 
-    connect(this, &Disassembler::blockCountChanged, this, &Disassembler::updateLineNumberAreaWidth);
-    connect(this, &Disassembler::updateRequest, this, &Disassembler::updateLineNumberArea);
-    connect(this, &Disassembler::cursorPositionChanged, this, &Disassembler::highlightCurrentLine);
     connect(this, &Disassembler::customContextMenuRequested, this, &Disassembler::showContextMenu);
-    connect(&lineHighlighter, &LineHighlighter::onAdded, this, &Disassembler::highlightCurrentLine);
+    connect(&lineHighlighter, &LineHighlighter::onAdded, viewport(), qOverload<>(&QWidget::update));
 }
 
 int Disassembler::lineNumberAreaWidth() const {
     int space = 3;
-    if (lines.empty())
+    if (!lines || lines->empty())
         return space;
 
-    int digits = 1;
-    int max    = lines.back().from;
+    int         digits = 1;
+    std::size_t max    = lines->from.back();
     while (max >= 16) {
         max /= 16;
         ++digits;
@@ -87,112 +91,373 @@ int Disassembler::lineNumberAreaWidth() const {
 void Disassembler::lineNumberAreaPaintEvent(QPaintEvent *event) {
     QPainter painter(lineNumberArea);
     painter.fillRect(event->rect(), Qt::lightGray);
+    painter.setPen(Qt::black);
 
-    QTextBlock block       = firstVisibleBlock();
-    int        blockNumber = block.blockNumber();
-    int        top         = qRound(blockBoundingGeometry(block).translated(contentOffset()).top());
-    int        bottom      = top + qRound(blockBoundingRect(block).height());
+    const int height = rowHeight();
+    for (int row = verticalScrollBar()->value(), top = 0; row < rowCount() && top <= event->rect().bottom(); ++row, top += height) {
+        if (top + height >= event->rect().top()) {
+            QString number = QStringLiteral("%1").arg(lines->from[row], 8, 16, QLatin1Char('0'));
+            painter.drawText(0, top, lineNumberArea->width(), height, Qt::AlignRight, number);
+        }
+    }
+}
 
-    while (block.isValid() && top <= event->rect().bottom()) {
-        if (block.isVisible() && bottom >= event->rect().top() && lines.size() > blockNumber) {
-            QString number = QStringLiteral("%1").arg(lines[blockNumber].from, 8, 16, QLatin1Char('0'));
-            painter.setPen(Qt::black);
-            painter.drawText(0, top, lineNumberArea->width(), fontMetrics().height(), Qt::AlignRight, number);
+void Disassembler::paintEvent(QPaintEvent * /* event */) {
+    QPainter painter{viewport()};
+    painter.setPen(palette().text().color());
+
+    const int    height    = rowHeight();
+    const int    first     = verticalScrollBar()->value();
+    const int    last      = qMin(rowCount(), first + visibleRows() + 1);
+    const QColor lineColor = QColor(Qt::yellow).lighter(160);
+    const auto [start, end] = selection();
+
+    QTextCharFormat selectionFormat;
+    selectionFormat.setBackground(palette().highlight());
+    selectionFormat.setForeground(palette().highlightedText());
+
+    // highlights of the visible bytes, a row is colored by the first one overlapping its bytes
+    std::vector<LineHighlighter::Range> highlights;
+    if (first < last) {
+        std::size_t end = lines->to[first];
+        for (int row = first + 1; row < last; ++row) {
+            end = std::max(end, lines->to[row]);
         }
+        highlights = lineHighlighter.ranges(lines->from[first], end);
+    }
+
+    int width = contentWidth;
+    for (int row = first; row < last; ++row) {
+        const QRect rect{0, (row - first) * height, viewport()->width(), height};
+        if (const auto color = LineHighlighter::color(highlights, lines->from[row], lines->to[row])) {
+            painter.fillRect(rect, *color);
+        }
+        if (row == cursor.row) {
+            painter.fillRect(rect, lineColor);
+        }
+
+        QTextLayout layout;
+        layoutRow(layout, row);
 
-        block  = block.next();
-        top    = bottom;
-        bottom = top + qRound(blockBoundingRect(block).height());
-        ++blockNumber;
+        QList<QTextLayout::FormatRange> selections;
+        if (start != end && start.row <= row && row <= end.row) {
+            const int from = row == start.row ? start.column : 0;
+            const int to   = row == end.row ? end.column : layout.text().size();
+            selections.append({from, to - from, selectionFormat});
+        }
+
+        const QPointF pos{static_cast<qreal>(textMargin - horizontalScrollBar()->value()), static_cast<qreal>(rect.top())};
+        layout.draw(&painter, pos, selections);
+        if (row == cursor.row && hasFocus()) {
+            layout.drawCursor(&painter, pos, cursor.column);
+        }
+        width = qMax(width, qCeil(layout.lineAt(0).naturalTextWidth()));
+    }
+
+    if (width != contentWidth) {
+        contentWidth = width;
+        updateScrollBars();
     }
 }
 
 void Disassembler::resizeEvent(QResizeEvent *e) {
-    QPlainTextEdit::resizeEvent(e);
+    QAbstractScrollArea::resizeEvent(e);
 
     const QRect cr = contentsRect();
     lineNumberArea->setGeometry(QRect(cr.left(), cr.top(), lineNumberAreaWidth(), cr.height()));
+    updateScrollBars();
 }
 
-void Disassembler::updateLineNumberAreaWidth(int /* newBlockCount */) {
-    setViewportMargins(lineNumberAreaWidth(), 0, 0, 0);
+void Disassembler::scrollContentsBy(int /* dx */, int dy) {
+    viewport()->update();
+    if (dy) {
+        lineNumberArea->update();
+    }
 }
 
-void Disassembler::highlightCurrentLine() {
-    QTextEdit::ExtraSelection selection;
+void Disassembler::keyPressEvent(QKeyEvent *event) {
+    if (event == QKeySequence::Copy) {
+        QGuiApplication::clipboard()->setText(selectedText());
+        return;
+    }
+    if (event == QKeySequence::SelectAll) {
+        anchor = {};
+        moveCursor({rowCount() - 1, std::numeric_limits<int>::max()}, true);
+        return;
+    }
 
-    const QColor lineColor = QColor(Qt::yellow).lighter(160);
-    selection.format.setBackground(lineColor);
-    selection.format.setProperty(QTextFormat::FullWidthSelection, true);
-    selection.cursor = textCursor();
-    selection.cursor.clearSelection();
+    const bool ctrl = event->modifiers().testFlag(Qt::ControlModifier);
+    Position   pos  = cursor;
+    switch (event->key()) {
+    case Qt::Key_Up:
+        --pos.row;
+        break;
+    case Qt::Key_Down:
+        ++pos.row;
+        break;
+    case Qt::Key_PageUp:
+        pos.row -= visibleRows();
+        break;
+    case Qt::Key_PageDown:
+        pos.row += visibleRows();
+        break;
+    case Qt::Key_Left:
+        if (pos.column > 0) {
+            --pos.column;
+        } else if (pos.row > 0) {
+            pos = {pos.row - 1, std::numeric_limits<int>::max()};
+        }
+        break;
+    case Qt::Key_Right:
+        if (pos.column < rowText(pos.row).size()) {
+            ++pos.column;
+        } else if (pos.row + 1 < rowCount()) {
+            pos = {pos.row + 1, 0};
+        }
+        break;
+    case Qt::Key_Home:
+        pos = {ctrl ? 0 : pos.row, 0};
+        break;
+    case Qt::Key_End:
+        pos = {ctrl ? rowCount() - 1 : pos.row, std::numeric_limits<int>::max()};
+        break;
+    default:
+        QAbstractScrollArea::keyPressEvent(event);
+        return;
+    }
+    moveCursor(pos, event->modifiers().testFlag(Qt::ShiftModifier));
+}
+
+void Disassembler::mousePressEvent(QMouseEvent *event) {
+    if (event->button() == Qt::LeftButton) {
+        moveCursor(positionAt(event->position().toPoint()), event->modifiers().testFlag(Qt::ShiftModifier));
+    }
+}
 
-    auto list = lineHighlighter.list();
-    list.append(selection);
-    setExtraSelections(list);
+void Disassembler::mouseMoveEvent(QMouseEvent *event) {
+    if (!event->buttons().testFlag(Qt::LeftButton)) {
+        return;
+    }
+    const QPoint point = event->position().toPoint();
+    if (point.y() < 0) {
+        verticalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepSub);
+    } else if (point.y() > viewport()->height()) {
+        verticalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepAdd);
+    }
+    moveCursor(positionAt(point), true);
 }
 
-void Disassembler::updateLineNumberArea(const QRect &rect, int dy) {
-    if (dy)
-        lineNumberArea->scroll(0, dy);
-    else
-        lineNumberArea->update(0, rect.y(), lineNumberArea->width(), rect.height());
+void Disassembler::mouseDoubleClickEvent(QMouseEvent *event) {
+    if (event->button() != Qt::LeftButton) {
+        return;
+    }
+    const Position pos          = positionAt(event->position().toPoint());
+    const auto [first, second] = wordAt(pos);
+    anchor                     = {pos.row, first};
+    moveCursor({pos.row, second}, true);
+}
+
+void Disassembler::focusInEvent(QFocusEvent *event) {
+    QAbstractScrollArea::focusInEvent(event);
+    viewport()->update();
+}
+
+void Disassembler::focusOutEvent(QFocusEvent *event) {
+    QAbstractScrollArea::focusOutEvent(event);
+    viewport()->update();
+}
+
+int Disassembler::rowCount() const {
+    return lines ? static_cast<int>(lines->size()) : 0;
+}
 
-    if (rect.contains(viewport()->rect()))
-        updateLineNumberAreaWidth(0);
+int Disassembler::rowHeight() const {
+    return fontMetrics().lineSpacing();
+}
+
+int Disassembler::visibleRows() const {
+    return qMax(1, viewport()->height() / rowHeight());
+}
+
+QString Disassembler::rowText(int row) const {
+    if (row < 0 || row >= rowCount()) {
+        return {};
+    }
+    const std::size_t index = static_cast<std::size_t>(row);
+    return QString{static_cast<qsizetype>(lines->indent[index]), tabChar} + QString::fromStdString(list->text(index));
+}
+
+void Disassembler::layoutRow(QTextLayout &layout, int row) const {
+    QTextOption option;
+    option.setWrapMode(QTextOption::NoWrap);
+    option.setTabStopDistance(tabDistance);
+
+    layout.setText(rowText(row));
+    layout.setFont(font());
+    layout.setTextOption(option);
+    layout.setFormats(rowFormats(row, layout.text()));
+    layout.beginLayout();
+    layout.createLine().setLineWidth(viewport()->width());
+    layout.endLayout();
+}
+
+std::vector<bclist::token> Disassembler::rowTokens(int row) const {
+    if (row < 0 || row >= rowCount()) {
+        return {};
+    }
+    return list->tokens(static_cast<std::size_t>(row));
+}
+
+QList<QTextLayout::FormatRange> Disassembler::rowFormats(int row, const QString &text) const {
+    const std::vector<bclist::token> tokens = rowTokens(row);
+    if (tokens.empty()) {
+        return syntaxHighlighter.highlight(text);
+    }
+
+    // token offsets are in bytes, they match the columns of ASCII lines only
+    const qsizetype indent = static_cast<qsizetype>(lines->indent[row]);
+    if (!isAscii(QStringView{text}.sliced(indent))) {
+        return syntaxHighlighter.highlight(text);
+    }
+    return syntaxHighlighter.highlight(tokens, indent);
+}
+
+QString Disassembler::nameAt(Position pos) const {
+    const std::vector<bclist::token> tokens = rowTokens(pos.row);
+    if (tokens.empty()) {
+        const auto [first, last] = wordAt(pos);
+        return rowText(pos.row).mid(first, last - first);
+    }
+
+    const qsizetype column = pos.column - static_cast<qsizetype>(lines->indent[pos.row]);
+    for (const bclist::token &t: tokens) {
+        if (t.key != bclist::symbol::none && column >= t.offset && column <= t.offset + t.length) {
+            const std::string_view name = list->symbols.name(t.key);
+            return QString::fromUtf8(name.data(), static_cast<qsizetype>(name.size()));
+        }
+    }
+    return {};
+}
+
+Disassembler::Position Disassembler::positionAt(const QPoint &pos) const {
+    if (rowCount() == 0) {
+        return {};
+    }
+    const int row = qBound(0, verticalScrollBar()->value() + pos.y() / rowHeight(), rowCount() - 1);
+
+    QTextLayout layout;
+    layoutRow(layout, row);
+    const qreal x = pos.x() + horizontalScrollBar()->value() - textMargin;
+    return {row, layout.lineAt(0).xToCursor(x)};
+}
+
+std::pair<Disassembler::Position, Disassembler::Position> Disassembler::selection() const {
+    return std::minmax(anchor, cursor);
+}
+
+std::pair<int, int> Disassembler::wordAt(Position pos) const {
+    const QString text  = rowText(pos.row);
+    int           first = qMin(pos.column, static_cast<int>(text.size()));
+    int           last  = first;
+    while (first > 0 && isWordChar(text[first - 1])) {
+        --first;
+    }
+    while (last < text.size() && isWordChar(text[last])) {
+        ++last;
+    }
+    return {first, last};
+}
+
+QString Disassembler::selectedText() const {
+    const auto [start, end] = selection();
+    QStringList result;
+    for (int row = start.row; row <= end.row && row < rowCount(); ++row) {
+        const QString text = rowText(row);
+        const int     from = row == start.row ? start.column : 0;
+        const int     to   = row == end.row ? end.column : text.size();
+        result.append(text.mid(from, to - from));
+    }
+    return result.join(QLatin1Char('\n'));
+}
+
+void Disassembler::moveCursor(Position pos, bool keepAnchor) {
+    pos.row    = qBound(0, pos.row, qMax(0, rowCount() - 1));
+    pos.column = qBound(0, pos.column, static_cast<int>(rowText(pos.row).size()));
+
+    const bool moved = pos != cursor;
+    cursor           = pos;
+    if (!keepAnchor) {
+        anchor = pos;
+    }
+
+    ensureVisible(cursor.row);
+    viewport()->update();
+    if (moved) {
+        emit cursorPositionChanged();
+    }
+}
+
+void Disassembler::ensureVisible(int row) {
+    QScrollBar *bar = verticalScrollBar();
+    if (row < bar->value()) {
+        bar->setValue(row);
+    } else if (row >= bar->value() + visibleRows()) {
+        bar->setValue(row - visibleRows() + 1);
+    }
+}
+
+void Disassembler::updateScrollBars() {
+    const int rows = visibleRows();
+    verticalScrollBar()->setRange(0, qMax(0, rowCount() - rows));
+    verticalScrollBar()->setPageStep(rows);
+    verticalScrollBar()->setSingleStep(1);
+
+    const int width = viewport()->width();
+    horizontalScrollBar()->setRange(0, qMax(0, contentWidth + 2 * textMargin - width));
+    horizontalScrollBar()->setPageStep(width);
+    horizontalScrollBar()->setSingleStep(fontMetrics().horizontalAdvance(QLatin1Char(' ')));
 }
 
 bool Disassembler::jump(std::size_t addr, bool last) {
-    const size_t l = utils::line_by_addr(lines, addr, last);
+    if (!lines) {
+        return false;
+    }
+    const size_t l = lines->line_at(addr, last);
     if (l == bclist::max_line) {
         return false;
     }
 
-    QTextCursor cursor{document()->findBlockByNumber(l)};
-    setTextCursor(cursor);
+    moveCursor({static_cast<int>(l), 0});
     return true;
 }
 
 bool Disassembler::jump(std::string_view name) {
-    const auto it = addrKeys.find(name);
-    if (it == addrKeys.end()) {
+    if (!list) {
         return false;
     }
 
-    std::size_t l = utils::line_by_addr(lines, it->second);
+    const std::size_t l = list->find_line(name);
     if (l == bclist::max_line) {
         return false;
     }
 
-    while (lines[l].key != name && lines[l].from <= it->second && lines[l].to >= it->second) {
-        l++;
-    }
-    QTextCursor cursor{document()->findBlockByNumber(l)};
-    setTextCursor(cursor);
+    moveCursor({static_cast<int>(l), 0});
     return true;
 }
 
 void Disassembler::highlight(std::size_t from, std::size_t to, QColor color) {
-    std::size_t first  = utils::line_by_addr(lines, from);
-    std::size_t second = utils::line_by_addr(lines, to, true);
-    if (first == bclist::max_line || second == bclist::max_line) {
-        return;
-    }
+    lineHighlighter.add(from, to, color);
+}
 
-    QTextBlock  block = document()->findBlockByNumber(first);
-    QTextCursor cursor{block};
-    block = document()->findBlockByNumber(second);
-    cursor.setPosition(block.position() + block.length(), QTextCursor::KeepAnchor);
-    lineHighlighter.add(cursor, color);
+void Disassembler::highlight(std::span<const std::pair<std::size_t, std::size_t>> ranges, QColor color) {
+    lineHighlighter.add(QList<std::pair<std::size_t, std::size_t>>{ranges.begin(), ranges.end()}, color);
 }
 
 std::size_t Disassembler::getCurrentAddress() const {
-    const int index = textCursor().block().blockNumber();
-    if (index < 0 || index >= lines.size()) {
+    if (!lines || static_cast<std::size_t>(cursor.row) >= lines->size()) {
         return 0;
     }
-    const auto currentLine = lines[index];
-    return currentLine.from;
+    return lines->span(cursor.row).first;
 }
 
 void Disassembler::showContextMenu(const QPoint &pos) {
@@ -202,15 +467,16 @@ void Disassembler::showContextMenu(const QPoint &pos) {
         return;
     }
 
-    const int index = textCursor().block().blockNumber();
-    if (index < 0 || index >= lines.size()) {
+    const int index = cursor.row;
+    if (!lines || index < 0 || index >= lines->size()) {
         return;
     }
-    const auto currentLine = lines[index];
+    const std::string currentKey{list->symbols.name(lines->keys[index])};
+    const std::size_t currentFrom = lines->from[index];
 
     QAction *actionCopy = nullptr, *actionAddress = nullptr, *actionGotoDef = nullptr, *actionHighlight = nullptr;
     QAction *actionXref[2] = {nullptr, nullptr};
-    if (!textCursor().selection().isEmpty()) {
+    if (anchor != cursor) {
         actionCopy = new QAction{"Copy", this};
         actionCopy->setShortcut(QKeySequence{Qt::CTRL | Qt::Key_C});
         contextMenu->addAction(actionCopy);
@@ -223,18 +489,16 @@ void Disassembler::showContextMenu(const QPoint &pos) {
     actionAddress = new QAction{"Copy an address", this};
     contextMenu->addAction(actionAddress);
 
-    textCursor().select(QTextCursor::WordUnderCursor);
-    const QString     word    = textCursor().selectedText();
+    const QString     word    = nameAt(cursor);
     const std::string stdword = word.toStdString();
-    textCursor().clearSelection();
-    bool hasWord = !word.isEmpty() && stdword != currentLine.key && addrKeys.find(stdword) != addrKeys.end();
+    bool hasWord = !word.isEmpty() && stdword != currentKey && list->find_line(stdword) != bclist::max_line;
 
     if (hasWord) {
         actionGotoDef = new QAction{QStringLiteral("Go to definition of \"%1\"").arg(word), this};
         contextMenu->addAction(actionGotoDef);
     }
-    if (!currentLine.key.empty()) {
-        actionXref[0] = new QAction{QStringLiteral("Find xrefs for \"%1\"").arg(QString::fromStdString(currentLine.key)), this};
+    if (!currentKey.empty()) {
+        actionXref[0] = new QAction{QStringLiteral("Find xrefs for \"%1\"").arg(QString::fromStdString(currentKey)), this};
         contextMenu->addAction(actionXref[0]);
     }
     if (hasWord) {
@@ -242,21 +506,22 @@ void Disassembler::showContextMenu(const QPoint &pos) {
         contextMenu->addAction(actionXref[1]);
     }
 
-    const QAction *action = contextMenu->exec(mapToGlobal(pos));
+    const QAction *action = contextMenu->exec(viewport()->mapToGlobal(pos));
     if (action) {
         if (action == actionCopy) {
-            QGuiApplication::clipboard()->setText(textCursor().selectedText());
+            QGuiApplication::clipboard()->setText(selectedText());
         } else if (action == actionAddress) {
-            QString address = QStringLiteral("%1").arg(currentLine.from, 8, 16, QLatin1Char('0'));
+            QString address = QStringLiteral("%1").arg(currentFrom, 8, 16, QLatin1Char('0'));
             QGuiApplication::clipboard()->setText(address);
         } else if (action == actionXref[0] || action == actionXref[1]) {
-            const std::string current = action == actionXref[0] ? currentLine.key : stdword;
-            XrefMenu         *menu    = new XrefMenu{this, file, addrKeys.find(current)->second};
+            const std::string current = action == actionXref[0] ? currentKey : stdword;
+            XrefMenu         *menu    = new XrefMenu{this, file, lines->from[list->find_line(current)]};
             emit              showXref(QStringLiteral("Xref for \"%1\"").arg(QString::fromStdString(current)), menu);
         } else if (action == actionGotoDef) {
             jump(stdword);
         } else if (action == actionHighlight) {
-            lineHighlighter.add(textCursor());
+            const auto [start, end] = selection();
+            lineHighlighter.add(lines->from[start.row], lines->to[end.row]);
         }
     }
 }
\ No newline at end of file
@@ -15,10 +15,12 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+
 #ifndef LUAD_DISASSEMBLER_HPP
 #define LUAD_DISASSEMBLER_HPP
 
-#include <QPlainTextEdit>
+#include <QTextLayout>
+#include <QAbstractScrollArea>
 
 #include "file.hpp"
 #include "linehighlighter.hpp"
@@ -27,7 +29,8 @@
 class LineNumberArea;
 class XrefMenu;
 
-class Disassembler : public QPlainTextEdit {
+// Listing of bclist lines, only the visible rows are laid out and painted.
+class Disassembler : public QAbstractScrollArea {
     Q_OBJECT
 
 public:
@@ -40,32 +43,67 @@ public:
     bool jump(std::string_view name);
 
     void highlight(std::size_t from, std::size_t to, QColor color);
+    void highlight(std::span<const std::pair<std::size_t, std::size_t>> ranges, QColor color); // [from, to] addresses
 
     std::size_t getCurrentAddress() const;
+    QString     selectedText() const;
 
 protected:
+    void paintEvent(QPaintEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+    void focusInEvent(QFocusEvent *event) override;
+    void focusOutEvent(QFocusEvent *event) override;
 
 signals:
+    void cursorPositionChanged();
     void showXref(const QString &name, XrefMenu *menu);
 
 private slots:
-    void updateLineNumberAreaWidth(int newBlockCount);
-    void highlightCurrentLine();
-    void updateLineNumberArea(const QRect &rect, int dy);
     void showContextMenu(const QPoint &pos);
 
 private:
-    LineNumberArea    *lineNumberArea;
-    SyntaxHighlighter *syntaxHighlighter;
+    struct Position {
+        int row = 0, column = 0;
+
+        auto operator<=>(const Position &) const = default;
+    };
+
+    int     rowCount() const;
+    int     rowHeight() const;
+    int     visibleRows() const;
+    QString rowText(int row) const;
+    void    layoutRow(QTextLayout &layout, int row) const;
+
+    std::vector<bclist::token>      rowTokens(int row) const;
+    QList<QTextLayout::FormatRange> rowFormats(int row, const QString &text) const;
+
+    Position                      positionAt(const QPoint &pos) const;
+    std::pair<Position, Position> selection() const;
+    std::pair<int, int>           wordAt(Position pos) const; // [start, end) columns of the word
+    QString                       nameAt(Position pos) const; // key of the token under pos, the word if the row has no tokens
+
+    void moveCursor(Position pos, bool keepAnchor = false);
+    void ensureVisible(int row);
+    void updateScrollBars();
+
+    LineNumberArea   *lineNumberArea;
+    SyntaxHighlighter syntaxHighlighter;
 
     LineHighlighter lineHighlighter;
 
     QMenu *contextMenu;
 
-    std::weak_ptr<File>                     file;
-    std::vector<bclist::div::line>          lines;
-    std::map<std::string_view, std::size_t> addrKeys;
+    Position cursor, anchor; // selection is [anchor, cursor]
+    int      contentWidth = 0; // widest row painted so far
+
+    std::weak_ptr<File>       file;
+    const bclist             *list  = nullptr;
+    const bclist::line_table *lines = nullptr;
 };
 
 class LineNumberArea : public QWidget {
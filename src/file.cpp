@@ -17,48 +17,154 @@
 
 #include "file.hpp"
 
+#include <algorithm>
+
 #include <QFile>
 #include <QMessageBox>
+#include <QStandardPaths>
+#include <QCoreApplication>
+
+#include "settings.hpp"
+#include "plugins/plugins.hpp"
+
+// instructions of the prototypes rendered for a preview, smaller files are shown when they are rendered
+constexpr std::size_t previewInstructions = 50000;
 
 File::File(QString path) {
     open(path);
 }
 
-bool File::open(QString p) {
-    QFile f{p};
-    if (!f.open(QIODevice::ReadOnly)) {
-        QMessageBox::warning(nullptr, "Warning", "Cannot open file: " + f.errorString());
-        return false;
+QString File::load(QString p, bool lazy, const listing_cache &cache, const bclist::progress_callback &progress, const preview_callback &preview) {
+    auto f = std::make_unique<QFile>(p);
+    if (!f->open(QIODevice::ReadOnly)) {
+        return "Cannot open file: " + f->errorString();
+    }
+
+    // regular files are mapped, the rest (pipes, devices) are read
+    QByteArray             copy;
+    std::span<const uchar> view;
+    uchar                 *map = f->size() > 0 ? f->map(0, f->size()) : nullptr;
+    if (map) {
+        view = {map, static_cast<std::size_t>(f->size())};
+    } else {
+        copy = f->readAll();
+        f.reset();
+        view = {reinterpret_cast<const uchar *>(copy.constData()), static_cast<std::size_t>(copy.size())};
     }
 
-    const QByteArray blob = f.readAll();
-    dislua::buffer   buf(blob.begin(), blob.end());
-    auto             info = dislua::read_all(buf);
+    // the parser's buffer is released as soon as the dump is read, and the dump once the lists have their copies
+    auto info = dislua::read_all(dislua::buffer(view.begin(), view.end()));
     if (!info) {
-        QMessageBox::warning(nullptr, "Warning", "Unknown compiler of Lua script.");
-        return false;
+        return "Unknown compiler of Lua script.";
+    }
+    auto list = bclist::get_list(*info);
+
+    // instruction lines of big scripts are formatted when they are shown
+    list->option.lazy = lazy;
+
+    const listing_cache::dump_key key = listing_cache::key(view, list->option);
+    if (map) {
+        // pages read while loading stay resident in the mapping, a new one only holds those the hex view shows
+        f->unmap(map);
+        map = f->map(0, f->size());
+        if (!map) {
+            return "Cannot map file: " + f->errorString();
+        }
+        view = {map, static_cast<std::size_t>(f->size())};
+        // the mapping outlives the loading thread
+        f->moveToThread(QCoreApplication::instance()->thread());
+    }
+
+    if (cache.load(key, *list)) {
+        info.reset();
+    } else {
+        std::size_t count = 0, instructions = 0;
+        while (count < info->protos.size() && instructions < previewInstructions) {
+            instructions += info->protos[count++].ins.size();
+        }
+        if (preview && count < info->protos.size()) {
+            // prototypes only refer to the ones before them, so the first ones are a dump of their own
+            info->protos.erase(info->protos.begin() + static_cast<std::ptrdiff_t>(count), info->protos.end());
+            auto head       = std::make_shared<File>();
+            head->path      = p;
+            head->dump_info = bclist::get_list(*info);
+            info.reset();
+            head->dump_info->option = list->option;
+            head->dump_info->update();
+
+            // bytes of the rendered prototypes
+            std::size_t end = 0;
+            for (std::size_t to: head->dump_info->lines.to) {
+                end = std::max(end, to + 1);
+            }
+            head->blob = QByteArray(reinterpret_cast<const char *>(view.data()), static_cast<qsizetype>(std::min(end, view.size())));
+            head->data = {reinterpret_cast<const uchar *>(head->blob.constData()), static_cast<std::size_t>(head->blob.size())};
+            preview(std::move(head));
+        }
+        info.reset();
+
+        list->progress = progress;
+        list->update();
+        list->progress = {};
+        if (list->lines.empty()) {
+            return "Loading was canceled.";
+        }
+        cache.store(key, *list);
     }
 
     path      = p;
-    dump_info = bclist::get_list(*info);
-    dump_info->update();
+    mapped    = std::move(f);
+    blob      = std::move(copy);
+    data      = view;
+    dump_info = std::move(list);
+    return {};
+}
+
+bool File::open(QString p) {
+    const QString error = load(p, Settings::instance()->value(Settings::lazyLinesKey, false).toBool(), cache());
+    if (!error.isEmpty()) {
+        QMessageBox::warning(nullptr, "Warning", error);
+        return false;
+    }
     return true;
 }
 
+listing_cache File::cache() {
+    const Settings *settings = Settings::instance();
+    if (!settings->value(Settings::cacheEnabledKey, true).toBool()) {
+        return listing_cache{};
+    }
+
+    const QString        dir  = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/listings";
+    const std::uintmax_t size = settings->value(Settings::cacheSizeKey, 512).toULongLong() * 1024 * 1024;
+    return listing_cache{std::filesystem::path{dir.toStdU16String()}, size};
+}
+
 bool File::save() {
+    // write() rewrites the buffer of the dump the plugins share
+    LuaPluginManager::instance()->cancel();
     dump_info->info->write();
+    const auto buf = dump_info->info->buf.copy_data();
+
+    // the mapping is released before the file is overwritten, the saved bytes are shown instead
+    blob = QByteArray(reinterpret_cast<const char *>(buf.data()), buf.size());
+    data = {reinterpret_cast<const uchar *>(blob.constData()), static_cast<std::size_t>(blob.size())};
+    mapped.reset();
+
     QFile f{path};
     if (!f.open(QIODevice::WriteOnly)) {
         QMessageBox::warning(nullptr, "Warning", "Cannot open file: " + f.errorString());
         return false;
     }
 
-    const auto buf = dump_info->info->buf.copy_data();
-    f.write(std::bit_cast<const char *>(buf.data()), buf.size());
+    f.write(reinterpret_cast<const char *>(buf.data()), buf.size());
     return true;
 }
 
 void File::close() {
     path = "";
     dump_info.reset();
+    data = {};
+    mapped.reset();
+    blob.clear();
 }
\ No newline at end of file
@@ -18,24 +18,48 @@
 #ifndef LUAD_FILE_HPP
 #define LUAD_FILE_HPP
 
+#include <span>
+
+#include <QFile>
 #include <QString>
+#include <QByteArray>
 
+#include "cache.hpp"
 #include "bclist.hpp"
 
 struct File {
     QString                 path;
-    std::unique_ptr<bclist> dump_info;
+    std::shared_ptr<bclist> dump_info; // shared with the plugins, they keep reading it after the file is closed
+
+    // Bytes of the opened file: a mapping of it, or a copy if it can't be mapped.
+    std::span<const uchar> bytes() const {
+        return data;
+    }
 
     File() = default;
     File(QString path);
 
-    bool open(QString path);
+    // Called by load() in its thread with the first prototypes of a big file, rendered before the others.
+    using preview_callback = std::function<void(std::shared_ptr<File> head)>;
+
+    // Read and render the file without showing anything, returns an error message (empty on success).
+    // Can run in any thread, the progress callback may cancel rendering.
+    QString load(QString path, bool lazy, const listing_cache &cache = listing_cache{}, const bclist::progress_callback &progress = {}, const preview_callback &preview = {});
+    bool    open(QString path);
+
+    // Cache of rendered lists from the settings.
+    static listing_cache cache();
     bool save();
     void close();
 
     bool is_opened() const {
         return !path.isEmpty() && dump_info;
     };
+
+private:
+    std::unique_ptr<QFile> mapped; // owns the mapping
+    QByteArray             blob;
+    std::span<const uchar> data;
 };
 
 #endif // LUAD_FILE_HPP
\ No newline at end of file
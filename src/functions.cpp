@@ -15,60 +15,68 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#include "functions.hpp"
-
-#include <QHeaderView>
-
-#include "disassembler.hpp"
 
-Functions::Functions(Disassembler *disasm, std::weak_ptr<File> file) : QTableWidget{disasm}, disassembler{disasm}, file{file} {
-    verticalHeader()->hide();
-    horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
-    setSelectionBehavior(QAbstractItemView::SelectRows);
-
-    setColumnCount(3);
-    QStringList header;
-    header << "Name"
-           << "Start"
-           << "End";
-    setHorizontalHeaderLabels(header);
+#include "functions.hpp"
 
+FunctionsModel::FunctionsModel(std::weak_ptr<File> file) : file{file} {
     update();
-
-    connect(this, &QTableWidget::cellDoubleClicked, this, &Functions::jump);
 }
 
-void Functions::update() {
-    clearContents();
+void FunctionsModel::update() {
+    beginResetModel();
+    functions.clear();
 
-    auto ptr = file.lock();
-    if (!ptr || !ptr->is_opened()) {
-        return;
+    if (auto ptr = file.lock(); ptr && ptr->is_opened()) {
+        const auto &divs = ptr->dump_info->divs;
+        for (std::size_t i = 2; i < divs.additional.size(); i++) { // "i = 2" to exclude compiler & header info
+            const bclist::div &div = divs.additional[i];
+            functions.push_back({div.key, div.start(), div.end()});
+        }
     }
+    endResetModel();
+}
 
-    const auto &divs = ptr->dump_info->divs;
-    setRowCount(divs.additional.size() - 2);
-    for (int i = 2; i < divs.additional.size(); i++) { // "i = 2" to exclude compiler & header info
-        const bclist::div &div = divs.additional[i];
+int FunctionsModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(functions.size());
+}
 
-        QTableWidgetItem *name = new QTableWidgetItem{QString::fromStdString(div.key)};
-        name->setFlags(name->flags() & ~Qt::ItemIsEditable);
-        setItem(i - 2, 0, name);
+int FunctionsModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : 3;
+}
 
-        QTableWidgetItem *start = new QTableWidgetItem{QStringLiteral("%1").arg(div.start(), 8, 16, QLatin1Char('0'))};
-        start->setFlags(start->flags() & ~Qt::ItemIsEditable);
-        setItem(i - 2, 1, start);
+QVariant FunctionsModel::data(const QModelIndex &index, int role) const {
+    auto ptr = file.lock();
+    if (!ptr || !ptr->is_opened() || !index.isValid() || index.row() >= functions.size() || (role != Qt::DisplayRole && role != Qt::UserRole)) {
+        return {};
+    }
 
-        QTableWidgetItem *end = new QTableWidgetItem{QStringLiteral("%1").arg(div.end(), 8, 16, QLatin1Char('0'))};
-        end->setFlags(end->flags() & ~Qt::ItemIsEditable);
-        setItem(i - 2, 2, end);
+    const Function &func = functions[index.row()];
+    switch (index.column()) {
+    case 0: {
+        const std::string_view key = ptr->dump_info->symbols.name(func.key);
+        return QString::fromUtf8(key.data(), key.size());
+    }
+    case 1:
+        return role == Qt::UserRole ? QVariant::fromValue(func.start) : QStringLiteral("%1").arg(func.start, 8, 16, QLatin1Char('0'));
+    case 2:
+        return role == Qt::UserRole ? QVariant::fromValue(func.end) : QStringLiteral("%1").arg(func.end, 8, 16, QLatin1Char('0'));
+    default:
+        return {};
     }
 }
 
-void Functions::jump(int row) {
-    const QTableWidgetItem *name    = item(row, 0);
-    const QString           namestr = name->data(0).toString();
-    if (disassembler) {
-        disassembler->jump(namestr.toStdString());
+QVariant FunctionsModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return {};
     }
+    static const QStringList header = {"Name", "Start", "End"};
+    return header.value(section);
+}
+
+Functions::Functions(Disassembler *disasm, std::weak_ptr<File> file) : Functions{disasm, new FunctionsModel{file}} {}
+
+Functions::Functions(Disassembler *disasm, FunctionsModel *model) : SymbolList{disasm, model}, model{model} {}
+
+void Functions::update() {
+    model->update();
 }
\ No newline at end of file
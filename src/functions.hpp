@@ -15,16 +15,40 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+
 #ifndef LUAD_FUNCTIONS_HPP
 #define LUAD_FUNCTIONS_HPP
 
-#include <QTableWidget>
+#include <QAbstractTableModel>
 
 #include "file.hpp"
+#include "symbollist.hpp"
+
+// Prototypes of the opened file.
+class FunctionsModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    FunctionsModel(std::weak_ptr<File> file);
+
+    void update();
 
-class Disassembler;
+    int      rowCount(const QModelIndex &parent = {}) const override;
+    int      columnCount(const QModelIndex &parent = {}) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
 
-class Functions : public QTableWidget {
+private:
+    struct Function {
+        bclist::symbol key;
+        std::size_t    start, end;
+    };
+
+    std::weak_ptr<File>   file;
+    std::vector<Function> functions;
+};
+
+class Functions : public SymbolList {
     Q_OBJECT
 
 public:
@@ -32,12 +56,10 @@ public:
 
     void update();
 
-public slots:
-    void jump(int row);
-
 private:
-    Disassembler       *disassembler;
-    std::weak_ptr<File> file;
+    Functions(Disassembler *disasm, FunctionsModel *model);
+
+    FunctionsModel *model;
 };
 
 #endif // LUAD_FUNCTIONS_HPP
\ No newline at end of file
@@ -17,34 +17,102 @@
 
 #include "linehighlighter.hpp"
 
-#include <QColorDialog>
+#include <algorithm>
 
-#include "disassembler.hpp"
+#include <QColorDialog>
 
-void LineHighlighter::add(QTextCursor cursor) {
+void LineHighlighter::add(std::size_t first, std::size_t last) {
     const QColor col = QColorDialog::getColor();
     if (!col.isValid()) {
         return;
     }
-    add(cursor, col);
+    add(first, last, col);
 }
 
-void LineHighlighter::add(QTextCursor cursor, QColor col) {
-    QTextEdit::ExtraSelection selection;
-    selection.format.setBackground(col);
-    selection.format.setProperty(QTextFormat::FullWidthSelection, true);
+void LineHighlighter::add(std::size_t first, std::size_t last, QColor col) {
+    if (first > last) {
+        std::swap(first, last);
+    }
+    paint(first, last, col);
+    emit onAdded();
+}
 
-    QTextCursor start = cursor;
-    start.setPosition(cursor.selectionStart());
-    QTextCursor end = cursor;
-    end.setPosition(cursor.selectionEnd());
-    while (start <= end && !start.atEnd()) {
-        // start.movePosition(QTextCursor::EndOfLine);
-        selection.cursor = start;
-        list_.append(selection);
-        // start.movePosition(QTextCursor::StartOfLine);
-        start.movePosition(QTextCursor::Down);
+void LineHighlighter::add(QList<std::pair<std::size_t, std::size_t>> ranges, QColor col) {
+    if (ranges.isEmpty()) {
+        return;
     }
+    for (auto &[first, last]: ranges) {
+        if (first > last) {
+            std::swap(first, last);
+        }
+    }
+    std::sort(ranges.begin(), ranges.end());
 
+    Range current{ranges.front().first, ranges.front().second, col};
+    for (const auto &[first, last]: ranges) {
+        if (first > current.last + 1) {
+            paint(current.first, current.last, col);
+            current.first = first;
+        }
+        current.last = std::max(current.last, last);
+    }
+    paint(current.first, current.last, col);
     emit onAdded();
+}
+
+std::vector<LineHighlighter::Range> LineHighlighter::ranges(std::size_t first, std::size_t last) const {
+    auto it = ranges_.upper_bound(first);
+    if (it != ranges_.begin() && std::prev(it)->second.last >= first) {
+        --it;
+    }
+
+    std::vector<Range> result;
+    for (; it != ranges_.end() && it->first <= last; ++it) {
+        result.push_back(it->second);
+    }
+    return result;
+}
+
+std::optional<QColor> LineHighlighter::color(std::span<const Range> ranges, std::size_t first, std::size_t last) {
+    // disjoint ranges sorted by the first byte are sorted by the last one too
+    const auto it = std::lower_bound(ranges.begin(), ranges.end(), first, [](const Range &r, std::size_t addr) {
+        return r.last < addr;
+    });
+    if (it == ranges.end() || it->first > last) {
+        return std::nullopt;
+    }
+    return it->color;
+}
+
+void LineHighlighter::paint(std::size_t first, std::size_t last, QColor col) {
+    // cut [first, last] out of the stored ranges
+    auto it = ranges_.upper_bound(first);
+    if (it != ranges_.begin() && std::prev(it)->second.last >= first) {
+        --it;
+    }
+    while (it != ranges_.end() && it->first <= last) {
+        const Range old = it->second;
+        it              = ranges_.erase(it);
+        if (old.first < first) {
+            ranges_.emplace(old.first, Range{old.first, first - 1, old.color});
+        }
+        if (old.last > last) {
+            ranges_.emplace(last + 1, Range{last + 1, old.last, old.color});
+        }
+    }
+
+    Range range{first, last, col};
+    auto  next = ranges_.upper_bound(last);
+    if (next != ranges_.end() && next->first == last + 1 && next->second.color == col) {
+        range.last = next->second.last;
+        next       = ranges_.erase(next);
+    }
+    if (next != ranges_.begin()) {
+        const auto prev = std::prev(next);
+        if (prev->second.last + 1 == first && prev->second.color == col) {
+            range.first = prev->first;
+            ranges_.erase(prev);
+        }
+    }
+    ranges_.emplace(range.first, range);
 }
\ No newline at end of file
@@ -18,25 +18,45 @@
 #ifndef LUAD_LINEHIGHLIGHTER_HPP
 #define LUAD_LINEHIGHLIGHTER_HPP
 
-#include <QTextEdit>
-#include <QTextCharFormat>
-#include <QRegularExpression>
+#include <map>
+#include <span>
+#include <vector>
+#include <optional>
 
+#include <QList>
+#include <QColor>
+#include <QObject>
+
+// Colored ranges of bytes [first, last], a range added later paints over the earlier ones.
+// Kept as sorted disjoint intervals, neighbours of the same color are merged.
 class LineHighlighter : public QObject {
     Q_OBJECT
 public:
+    struct Range {
+        std::size_t first, last;
+        QColor      color;
+    };
+
     LineHighlighter() = default;
 
-    void add(QTextCursor cursor);
-    void add(QTextCursor cursor, QColor col);
+    void add(std::size_t first, std::size_t last);
+    void add(std::size_t first, std::size_t last, QColor col);
+    // Adds the ranges with one color at once, onAdded is emitted once.
+    void add(QList<std::pair<std::size_t, std::size_t>> ranges, QColor col);
 
-    QList<QTextEdit::ExtraSelection> list() const { return list_; }
+    // Ranges overlapping [first, last], sorted by address.
+    std::vector<Range> ranges(std::size_t first, std::size_t last) const;
+
+    // Color of the first range of `ranges` overlapping [first, last].
+    static std::optional<QColor> color(std::span<const Range> ranges, std::size_t first, std::size_t last);
 
 signals:
     void onAdded();
 
 private:
-    QList<QTextEdit::ExtraSelection> list_;
+    void paint(std::size_t first, std::size_t last, QColor col);
+
+    std::map<std::size_t, Range> ranges_; // by the first byte
 };
 
 #endif // LUAD_LINEHIGHLIGHTER_HPP
\ No newline at end of file
@@ -21,11 +21,15 @@
 #include <QDockWidget>
 #include <QFileDialog>
 #include <QMessageBox>
+#include <QTreeWidget>
 #include <QInputDialog>
+#include <QProgressDialog>
 #include <QCoreApplication>
 
+#include "byteview.hpp"
 #include "xrefmenu.hpp"
 #include "settings.hpp"
+#include "pluginlog.hpp"
 #include "functions.hpp"
 #include "variables.hpp"
 #include "disassembler.hpp"
@@ -36,35 +40,131 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow{parent}, file{std::make_sh
     readSettings();
     initializeMenubar();
 
+    const auto logSize = Settings::instance()->value(Settings::pluginLogSizeKey, static_cast<qulonglong>(PluginLogModel::defaultCapacity)).toULongLong();
+    logModel           = new PluginLogModel{this, static_cast<std::size_t>(logSize)};
+
     connect(this, &MainWindow::openFile, this, &MainWindow::initializeDisassembler);
     connect(this, &MainWindow::openFile, LuaPluginManager::instance(), &LuaPluginManager::openFile);
-    connect(LuaPluginManager::instance(), &LuaPluginManager::onMessage, this, &MainWindow::onMessage);
+    connect(LuaPluginManager::instance(), &LuaPluginManager::onMessage, logModel, &PluginLogModel::append);
+    connect(LuaPluginManager::instance(), &LuaPluginManager::statusChanged, this, &MainWindow::onPluginStatus);
 
     LuaPluginManager::instance()->setParent(this);
     LuaPluginManager::instance()->loadPlugins();
 }
 
 MainWindow::~MainWindow() {
-    disconnect(LuaPluginManager::instance(), &LuaPluginManager::onMessage, this, &MainWindow::onMessage);
+    LuaPluginManager::instance()->cancel();
+    disconnect(LuaPluginManager::instance(), &LuaPluginManager::onMessage, logModel, &PluginLogModel::append);
+    disconnect(LuaPluginManager::instance(), &LuaPluginManager::statusChanged, this, &MainWindow::onPluginStatus);
+    if (loader) {
+        *cancelLoad = true;
+        loader->wait();
+        delete loader;
+    }
 }
 
 void MainWindow::openFileDialog() {
+    if (loader) { // another file is being opened
+        return;
+    }
     if (file->is_opened()) {
         closeFile();
     }
     const QString path = QFileDialog::getOpenFileName(this, tr("Open"), "", tr("Compiled lua script (*.luac)"));
-    if (!path.isEmpty() && file->open(path)) {
-        closeFileAction->setEnabled(true);
+    if (!path.isEmpty()) {
+        loadFile(path);
+    }
+}
+
+void MainWindow::loadFile(const QString &path) {
+    const QFileInfo fi{path};
+    const bool      lazy   = Settings::instance()->value(Settings::lazyLinesKey, false).toBool();
+    const auto      cache  = File::cache();
+    const auto      loaded = std::make_shared<File>();
+    const auto      error  = std::make_shared<QString>();
+    const auto      cancel = std::make_shared<std::atomic_bool>(false);
+    const auto      shown  = std::make_shared<bool>(false); // the first prototypes are shown
+
+    // busy until the dump is parsed, then the number of rendered prototypes
+    QProgressDialog *progress = new QProgressDialog{tr("Opening %1...").arg(fi.fileName()), tr("Cancel"), 0, 0, this};
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(500);
+    progress->setAutoReset(false);
+    progress->setAutoClose(false);
+    connect(progress, &QProgressDialog::canceled, [cancel] { *cancel = true; });
+
+    // the first prototypes of a big file are shown without plugins, the dialog stops blocking the window
+    const auto showPreview = [=, this](std::shared_ptr<File> head) {
+        if (*cancel) {
+            return;
+        }
+        if (file->is_opened()) {
+            closeFile();
+        }
+        *file  = std::move(*head);
+        *shown = true;
         jumpAction->setEnabled(true);
+        setWindowTitle(QString{"Luad - %1 (loading)"}.arg(fi.fileName()));
+        initializeDisassembler(file);
+
+        progress->hide();
+        progress->setWindowModality(Qt::NonModal);
+        progress->show();
+    };
+
+    loader = QThread::create([=, this] {
+        const auto onProgress = [=](std::size_t done, std::size_t total) {
+            // dropped if the dialog is already gone
+            QMetaObject::invokeMethod(progress, [=] {
+                progress->setMaximum(static_cast<int>(total));
+                progress->setValue(static_cast<int>(done));
+            }, Qt::QueuedConnection);
+            return !*cancel;
+        };
+        const auto onPreview = [=, this](std::shared_ptr<File> head) {
+            // handled before QThread::finished, both are queued to the window
+            QMetaObject::invokeMethod(this, [=] { showPreview(head); }, Qt::QueuedConnection);
+        };
+        *error = loaded->load(path, lazy, cache, onProgress, onPreview);
+    });
+    cancelLoad = cancel;
+
+    connect(loader, &QThread::finished, this, [=, this] {
+        progress->deleteLater();
+        loader->deleteLater();
+        loader = nullptr;
+        cancelLoad.reset();
+
+        // the views of the preview point into its list, they are made again for the whole file
+        std::size_t address = 0;
+        if (*shown) {
+            address = static_cast<Disassembler *>(disassembler->widget())->getCurrentAddress();
+            closeFile();
+        }
+        if (*cancel) {
+            return;
+        }
+        if (!error->isEmpty()) {
+            QMessageBox::warning(this, "Warning", *error);
+            return;
+        }
 
-        QFileInfo fi{path};
+        LuaPluginManager::instance()->cancel(); // plugins would highlight lines of the old file
+        *file = std::move(*loaded);
+        closeFileAction->setEnabled(true);
+        jumpAction->setEnabled(true);
         setWindowTitle(QString{"Luad - %1"}.arg(fi.fileName()));
 
         emit openFile(file);
-    }
+        if (*shown) {
+            static_cast<Disassembler *>(disassembler->widget())->jump(address);
+        }
+    });
+    loader->start();
 }
 
 void MainWindow::closeFile() {
+    LuaPluginManager::instance()->cancel();
     setWindowTitle("Luad");
     file->close();
     closeFileAction->setEnabled(false);
@@ -75,6 +175,7 @@ void MainWindow::closeFile() {
     removeDock(disassembler);
     removeDock(hexEditor);
     removeDock(pluginLogs);
+    removeDock(plugins);
     if (xref) {
         removeDock(xref);
     }
@@ -145,10 +246,14 @@ void MainWindow::initializeDisassembler(std::weak_ptr<File> file) {
         }
     });
 
-    QPlainTextEdit *logsEdit = new QPlainTextEdit{this};
-    logsEdit->setReadOnly(true);
-    logsEdit->setPlainText(logs);
-    pluginLogs = addDock(tr("Plugin logs"), logsEdit, Qt::RightDockWidgetArea);
+    pluginLogs = addDock(tr("Plugin logs"), new PluginLog{this, logModel}, Qt::RightDockWidgetArea);
+
+    QTreeWidget *states = new QTreeWidget{this};
+    states->setHeaderLabels({tr("Plugin"), tr("Status")});
+    states->setRootIsDecorated(false);
+    plugins = addDock(tr("Plugins"), states, Qt::RightDockWidgetArea);
+    tabifyDockWidget(pluginLogs, plugins);
+    showPluginStates();
 }
 
 void MainWindow::showXref(const QString &name, XrefMenu *menu) {
@@ -163,15 +268,32 @@ void MainWindow::showXref(const QString &name, XrefMenu *menu) {
     xref->raise();
 }
 
-void MainWindow::onMessage(std::string_view text) {
-    if (!logs.isEmpty()) {
-        logs.append('\n');
+void MainWindow::onPluginStatus(const QString &plugin, LuaPluginManager::Status status) {
+    switch (status) {
+    case LuaPluginManager::Status::Running:
+        pluginStates[plugin] = tr("Running");
+        break;
+    case LuaPluginManager::Status::Finished:
+        pluginStates[plugin] = tr("Finished");
+        break;
+    case LuaPluginManager::Status::Canceled:
+        pluginStates[plugin] = tr("Canceled");
+        break;
+    case LuaPluginManager::Status::Failed:
+        pluginStates[plugin] = tr("Failed");
+        break;
     }
-    logs.append(QString::fromUtf8(text.data(), text.size()));
+    showPluginStates();
+}
 
-    if (pluginLogs) {
-        auto logsEdit = qobject_cast<QPlainTextEdit *>(pluginLogs->widget());
-        logsEdit->setPlainText(logs);
+void MainWindow::showPluginStates() {
+    if (!plugins) {
+        return;
+    }
+    auto states = qobject_cast<QTreeWidget *>(plugins->widget());
+    states->clear();
+    for (auto it = pluginStates.cbegin(); it != pluginStates.cend(); ++it) {
+        states->addTopLevelItem(new QTreeWidgetItem{QStringList{it.key(), it.value()}});
     }
 }
 
@@ -221,12 +343,10 @@ void MainWindow::removeDock(QDockWidget *&widget) {
 }
 
 QHexEdit *MainWindow::addHexEditor() {
-    const std::vector<dislua::uchar> bytes = file->dump_info->info->buf.copy_data();
-    QByteArray                       buffer(std::bit_cast<const char *>(bytes.data()), bytes.size());
-
     QHexEdit *hexEdit = new QHexEdit{this};
     hexEdit->setReadOnly(true);
-    hexEdit->setData(buffer);
+    // the hex editor reads chunks of the file bytes on demand
+    hexEdit->setData(*new ByteView{file, hexEdit});
     return hexEdit;
 }
 
@@ -250,10 +370,45 @@ void MainWindow::closeEvent(QCloseEvent *event) {
     writeSettings();
 }
 
-void MainWindow::highlight(std::size_t from, std::size_t to, QColor color) {
+void MainWindow::highlight(std::size_t from, std::size_t to, QColor color, std::uint64_t generation) {
+    const std::pair<std::size_t, std::size_t> range{from, to};
+    highlight(std::span{&range, 1}, color, generation);
+}
+
+void MainWindow::highlight(std::span<const std::pair<std::size_t, std::size_t>> ranges, QColor color, std::uint64_t generation) {
+    if (ranges.empty()) {
+        return;
+    }
+    if (pendingHighlights.empty()) {
+        QMetaObject::invokeMethod(this, &MainWindow::applyHighlights, Qt::QueuedConnection);
+    }
+    for (const auto &[from, to]: ranges) {
+        pendingHighlights.push_back({from, to, color, generation});
+    }
+}
+
+void MainWindow::applyHighlights() {
+    // queued by plugins canceled since, the file they ran for is closed or replaced
+    std::vector<PendingHighlight> pending = std::exchange(pendingHighlights, {});
+    std::erase_if(pending, [generation = LuaPluginManager::instance()->generation()](const PendingHighlight &h) {
+        return h.generation != generation;
+    });
+    if (!disassembler) { // queued by a plugin after the file was closed
+        return;
+    }
     Disassembler *disasm = qobject_cast<Disassembler *>(disassembler->widget());
-    if (disasm) {
-        disasm->highlight(from, to, color);
+    if (!disasm) {
+        return;
+    }
+
+    // the later highlight is on top, so only the runs of one color are merged
+    std::vector<std::pair<std::size_t, std::size_t>> ranges;
+    for (std::size_t i = 0; i < pending.size(); i++) {
+        ranges.emplace_back(pending[i].from, pending[i].to);
+        if (i + 1 == pending.size() || pending[i + 1].color != pending[i].color) {
+            disasm->highlight(ranges, pending[i].color);
+            ranges.clear();
+        }
     }
 }
 
@@ -18,6 +18,11 @@
 #ifndef LUAD_MAINWINDOW_HPP
 #define LUAD_MAINWINDOW_HPP
 
+#include <atomic>
+#include <vector>
+
+#include <QMap>
+#include <QThread>
 #include <QMainWindow>
 #include <qhexedit.h>
 
@@ -25,6 +30,7 @@
 #include "plugins/plugins.hpp"
 
 class XrefMenu;
+class PluginLogModel;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -35,7 +41,10 @@ public:
 
     void closeEvent(QCloseEvent *event) override;
 
-    void highlight(std::size_t from, std::size_t to, QColor color);
+    // Highlights are collected and applied to the disassembler once per event loop turn.
+    // Those of an older generation of plugin runs (LuaPluginManager::generation()) belong to another file and are dropped.
+    void highlight(std::size_t from, std::size_t to, QColor color, std::uint64_t generation);
+    void highlight(std::span<const std::pair<std::size_t, std::size_t>> ranges, QColor color, std::uint64_t generation);
 
     static MainWindow *instance();
 
@@ -48,18 +57,32 @@ public slots:
     void jumpDialog();
     void initializeDisassembler(std::weak_ptr<File> file);
     void showXref(const QString &name, XrefMenu *menu);
-    void onMessage(std::string_view text);
+    void onPluginStatus(const QString &plugin, LuaPluginManager::Status status);
 
 private:
     void         initializeMenubar();
     QDockWidget *addDock(const QString &title, QWidget *widget, Qt::DockWidgetArea area = Qt::TopDockWidgetArea);
     void         removeDock(QDockWidget *&widget);
     QHexEdit    *addHexEditor();
+    void         loadFile(const QString &path);
+    void         showPluginStates();
+    void         applyHighlights();
+
+    PluginLogModel        *logModel = nullptr; // kept between files
+    QMap<QString, QString> pluginStates;       // plugin name -> status of its last run
 
-    QString logs;
+    struct PendingHighlight {
+        std::size_t   from, to;
+        QColor        color;
+        std::uint64_t generation;
+    };
+    std::vector<PendingHighlight> pendingHighlights;
 
     std::shared_ptr<File> file;
 
+    QThread                          *loader = nullptr; // renders the file being opened
+    std::shared_ptr<std::atomic_bool> cancelLoad;
+
     QAction *closeFileAction = nullptr;
     QAction *jumpAction      = nullptr;
     QMenu   *viewMenu        = nullptr;
@@ -70,6 +93,7 @@ private:
     QDockWidget *xref         = nullptr;
     QDockWidget *hexEditor    = nullptr;
     QDockWidget *pluginLogs   = nullptr;
+    QDockWidget *plugins      = nullptr;
 
     void readSettings();
     void writeSettings();
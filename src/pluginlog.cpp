@@ -0,0 +1,211 @@
+// Luad - Disassembler for compiled Lua scripts.
+// https://github.com/imring/Luad
+// Copyright (C) 2021-2023 Vitaliy Vorobets
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pluginlog.hpp"
+
+#include <algorithm>
+
+#include <QComboBox>
+#include <QTableView>
+#include <QScrollBar>
+#include <QHeaderView>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+
+namespace {
+QString typeName(LuaPluginManager::MessageType type) {
+    switch (type) {
+    case LuaPluginManager::MessageType::Info:
+        return QStringLiteral("info");
+    case LuaPluginManager::MessageType::Script:
+        return QStringLiteral("script");
+    case LuaPluginManager::MessageType::Error:
+        return QStringLiteral("error");
+    }
+    return {};
+}
+} // namespace
+
+PluginLogModel::PluginLogModel(QObject *parent, std::size_t capacity) : QAbstractTableModel{parent}, capacity{std::max<std::size_t>(capacity, 1)} {}
+
+void PluginLogModel::append(LuaPluginManager::MessageType type, const QString &plugin, const QString &text, const QDateTime &time) {
+    if (pending.empty()) {
+        QMetaObject::invokeMethod(this, &PluginLogModel::flush, Qt::QueuedConnection);
+    }
+    pending.push_back({time, type, plugin, text});
+}
+
+void PluginLogModel::flush() {
+    std::vector<Entry> added = std::exchange(pending, {});
+    if (added.empty()) {
+        return;
+    }
+    // only the newest messages fit
+    if (added.size() > capacity) {
+        added.erase(added.begin(), added.end() - static_cast<std::ptrdiff_t>(capacity));
+    }
+
+    for (const Entry &e: added) {
+        if (!e.plugin.isEmpty() && !plugins_.contains(e.plugin)) {
+            plugins_.append(e.plugin);
+            emit pluginAdded(e.plugin);
+        }
+    }
+
+    if (count + added.size() > capacity) {
+        const std::size_t dropped = count + added.size() - capacity;
+        beginRemoveRows({}, 0, static_cast<int>(dropped) - 1);
+        first = (first + dropped) % capacity;
+        count -= dropped;
+        endRemoveRows();
+    }
+
+    beginInsertRows({}, static_cast<int>(count), static_cast<int>(count + added.size()) - 1);
+    for (Entry &e: added) {
+        const std::size_t slot = (first + count) % capacity;
+        if (slot == entries.size()) {
+            entries.push_back(std::move(e));
+        } else {
+            entries[slot] = std::move(e);
+        }
+        count++;
+    }
+    endInsertRows();
+}
+
+const PluginLogModel::Entry &PluginLogModel::at(int row) const {
+    return entries[(first + static_cast<std::size_t>(row)) % capacity];
+}
+
+int PluginLogModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(count);
+}
+
+int PluginLogModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : 4;
+}
+
+QVariant PluginLogModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= rowCount()) {
+        return {};
+    }
+
+    const Entry &e = at(index.row());
+    if (role == typeRole) {
+        return QVariant::fromValue(e.type);
+    }
+    if (role != Qt::DisplayRole) {
+        return {};
+    }
+    switch (index.column()) {
+    case TimeColumn:
+        return e.time.toString(QStringLiteral("dd.MM.yyyy HH:mm:ss"));
+    case TypeColumn:
+        return typeName(e.type);
+    case PluginColumn:
+        return e.plugin;
+    case TextColumn:
+        return e.text;
+    default:
+        return {};
+    }
+}
+
+QVariant PluginLogModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return {};
+    }
+    static const QStringList header = {"Time", "Type", "Plugin", "Message"};
+    return header.value(section);
+}
+
+void PluginLogFilter::setPlugin(const QString &name) {
+    plugin = name;
+    invalidateFilter();
+}
+
+void PluginLogFilter::setType(std::optional<LuaPluginManager::MessageType> t) {
+    type = t;
+    invalidateFilter();
+}
+
+bool PluginLogFilter::filterAcceptsRow(int row, const QModelIndex &parent) const {
+    const QAbstractItemModel *model = sourceModel();
+    if (!plugin.isEmpty() && model->index(row, PluginLogModel::PluginColumn, parent).data().toString() != plugin) {
+        return false;
+    }
+    if (type && model->index(row, 0, parent).data(PluginLogModel::typeRole).value<LuaPluginManager::MessageType>() != *type) {
+        return false;
+    }
+    return true;
+}
+
+PluginLog::PluginLog(QWidget *parent, PluginLogModel *model)
+    : QWidget{parent}, proxy{new PluginLogFilter{this}}, plugins{new QComboBox{this}}, types{new QComboBox{this}}, view{new QTableView{this}} {
+    proxy->setSourceModel(model);
+
+    plugins->addItem(tr("All plugins"));
+    for (const QString &name: model->plugins()) {
+        addPlugin(name);
+    }
+    types->addItem(tr("All messages"));
+    types->addItem(tr("Info"), QVariant::fromValue(LuaPluginManager::MessageType::Info));
+    types->addItem(tr("Script"), QVariant::fromValue(LuaPluginManager::MessageType::Script));
+    types->addItem(tr("Errors"), QVariant::fromValue(LuaPluginManager::MessageType::Error));
+
+    view->setModel(proxy);
+    view->verticalHeader()->hide();
+    view->horizontalHeader()->setStretchLastSection(true);
+    view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    view->setWordWrap(false);
+    // all rows have the same height, so the view doesn't measure them
+    view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+
+    QHBoxLayout *filters = new QHBoxLayout;
+    filters->addWidget(plugins);
+    filters->addWidget(types);
+    QVBoxLayout *layout = new QVBoxLayout{this};
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addLayout(filters);
+    layout->addWidget(view);
+
+    connect(model, &PluginLogModel::pluginAdded, this, &PluginLog::addPlugin);
+    connect(plugins, &QComboBox::currentIndexChanged, this, [this](int index) {
+        proxy->setPlugin(index > 0 ? plugins->itemText(index) : QString{});
+    });
+    connect(types, &QComboBox::currentIndexChanged, this, [this](int index) {
+        const QVariant type = types->itemData(index);
+        proxy->setType(type.isValid() ? std::optional{type.value<LuaPluginManager::MessageType>()} : std::nullopt);
+    });
+
+    // stay at the bottom if it was there before the insertion
+    connect(proxy, &QAbstractItemModel::rowsAboutToBeInserted, this, [this] {
+        const QScrollBar *bar = view->verticalScrollBar();
+        follow                = bar->value() == bar->maximum();
+    });
+    connect(proxy, &QAbstractItemModel::rowsInserted, this, [this] {
+        if (follow) {
+            view->scrollToBottom();
+        }
+    });
+    view->scrollToBottom();
+}
+
+void PluginLog::addPlugin(const QString &name) {
+    plugins->addItem(name);
+}
\ No newline at end of file
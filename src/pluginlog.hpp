@@ -0,0 +1,120 @@
+// Luad - Disassembler for compiled Lua scripts.
+// https://github.com/imring/Luad
+// Copyright (C) 2021-2023 Vitaliy Vorobets
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef LUAD_PLUGINLOG_HPP
+#define LUAD_PLUGINLOG_HPP
+
+#include <vector>
+#include <optional>
+
+#include <QWidget>
+#include <QDateTime>
+#include <QStringList>
+#include <QAbstractTableModel>
+#include <QSortFilterProxyModel>
+
+#include "plugins/plugins.hpp"
+
+class QComboBox;
+class QTableView;
+
+// Last messages of the plugins in a ring buffer, the oldest ones are dropped when it's full.
+// Messages added during an event loop turn are inserted at once at the end of it.
+class PluginLogModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    static constexpr std::size_t defaultCapacity = 10000;
+
+    PluginLogModel(QObject *parent = nullptr, std::size_t capacity = defaultCapacity);
+
+    int      rowCount(const QModelIndex &parent = {}) const override;
+    int      columnCount(const QModelIndex &parent = {}) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    // Names of the plugins that sent messages, in order of appearance.
+    const QStringList &plugins() const { return plugins_; }
+
+    enum Column {
+        TimeColumn,
+        TypeColumn,
+        PluginColumn,
+        TextColumn,
+    };
+    static constexpr int typeRole = Qt::UserRole; // LuaPluginManager::MessageType of the row
+
+signals:
+    void pluginAdded(const QString &plugin);
+
+public slots:
+    void append(LuaPluginManager::MessageType type, const QString &plugin, const QString &text, const QDateTime &time);
+
+private:
+    struct Entry {
+        QDateTime                     time;
+        LuaPluginManager::MessageType type;
+        QString                       plugin, text;
+    };
+
+    void flush();
+    const Entry &at(int row) const;
+
+    std::size_t        capacity;
+    std::vector<Entry> entries;   // ring buffer
+    std::size_t        first = 0; // index of the oldest entry
+    std::size_t        count = 0;
+    std::vector<Entry> pending;   // appended since the last flush
+    QStringList        plugins_;
+};
+
+// Rows of one plugin and one message type, empty filters accept everything.
+class PluginLogFilter : public QSortFilterProxyModel {
+    Q_OBJECT
+
+public:
+    using QSortFilterProxyModel::QSortFilterProxyModel;
+
+    void setPlugin(const QString &name);
+    void setType(std::optional<LuaPluginManager::MessageType> type);
+
+protected:
+    bool filterAcceptsRow(int row, const QModelIndex &parent) const override;
+
+private:
+    QString                                      plugin;
+    std::optional<LuaPluginManager::MessageType> type;
+};
+
+// Log panel with the filters, follows new messages while it's scrolled to the bottom.
+class PluginLog : public QWidget {
+    Q_OBJECT
+
+public:
+    PluginLog(QWidget *parent, PluginLogModel *model);
+
+private:
+    void addPlugin(const QString &name);
+
+    PluginLogFilter *proxy;
+    QComboBox       *plugins;
+    QComboBox       *types;
+    QTableView      *view;
+    bool             follow = true;
+};
+
+#endif // LUAD_PLUGINLOG_HPP
\ No newline at end of file
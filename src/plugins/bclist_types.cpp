@@ -20,47 +20,166 @@
 #include "bclist.hpp"
 #include "../file.hpp"
 
+// The list seen from lua, read only. The refs share the list so they stay valid after the file is closed or reloaded.
+struct list_ref {
+    std::shared_ptr<const bclist> list;
+};
+
+// Lines and divs of a list seen from lua, the text of lines is taken from the list so deferred lines are formatted.
+struct line_ref {
+    std::shared_ptr<const bclist>      list;
+    const bclist::div::line           *line;
+    std::shared_ptr<const bclist::div> owned; // div of the line made for lua, null if the list owns it
+};
+
+struct div_ref {
+    std::shared_ptr<const bclist>      list;
+    const bclist::div                 *div;
+    std::shared_ptr<const bclist::div> owned; // the div made for lua (only_lines()), null if the list owns it
+};
+
+// Rows of the list, numbered from 1 like Lua arrays.
+struct lines_ref {
+    std::shared_ptr<const bclist> list;
+};
+
 void LuaCustom::initialize_bclist_types(sol::state &lua) {
-    lua.new_usertype<bclist::div::line>("bclistline",
+    lua.new_usertype<line_ref>("bclistline",
         sol::call_constructor, sol::no_constructor,
-        "text", &bclist::div::line::text,
-        "key", &bclist::div::line::key,
-        "from", &bclist::div::line::from,
-        "to", &bclist::div::line::to
+        "text", sol::property([](const line_ref &r) { return r.list->text(*r.line); }),
+        "key", sol::property([](const line_ref &r) { return r.list->symbols.name(r.line->key); }),
+        "key_id", sol::property([](const line_ref &r) { return r.line->key; }),
+        "from", sol::property([](const line_ref &r) { return r.line->from; }),
+        "to", sol::property([](const line_ref &r) { return r.line->to; })
     );
 
-    lua.new_usertype<bclist::div>("bclistdiv",
+    lua.new_usertype<div_ref>("bclistdiv",
         sol::call_constructor, sol::no_constructor,
-        "key", &bclist::div::key,
-        "header", &bclist::div::header,
-        "footer", &bclist::div::footer,
-        "lines", [](bclist::div &d) { return sol::as_table(d.lines); },
-        "additional", [](bclist::div &d) { return sol::as_table(d.additional); },
+        "key", sol::property([](const div_ref &r) { return r.list->symbols.name(r.div->key); }),
+        "key_id", sol::property([](const div_ref &r) { return r.div->key; }),
+        "header", sol::property([](const div_ref &r) { return r.div->header; }),
+        "footer", sol::property([](const div_ref &r) { return r.div->footer; }),
+        "lines", [](const div_ref &r) {
+            std::vector<line_ref> result;
+            result.reserve(r.div->lines.size());
+            for (const auto &l: r.div->lines) {
+                result.push_back({r.list, &l, r.owned});
+            }
+            return sol::as_table(std::move(result));
+        },
+        "additional", [](const div_ref &r) {
+            std::vector<div_ref> result;
+            result.reserve(r.div->additional.size());
+            for (const auto &d: r.div->additional) {
+                result.push_back({r.list, &d, r.owned});
+            }
+            return sol::as_table(std::move(result));
+        },
 
-        "string", &bclist::div::string,
-        "only_lines", &bclist::div::only_lines,
-        "empty", &bclist::div::empty,
-        "start", &bclist::div::start,
-        "ends", &bclist::div::end
+        "string", [](const div_ref &r, sol::optional<bool> from) { return r.list->string(*r.div, from.value_or(false)); },
+        "only_lines", [](const div_ref &r) {
+            auto d = std::make_shared<const bclist::div>(r.list->only_lines(*r.div));
+            return div_ref{r.list, d.get(), d};
+        },
+        "empty", [](const div_ref &r) { return r.list->empty(*r.div); },
+        "start", [](const div_ref &r) { return r.div->start(); },
+        "ends", [](const div_ref &r) { return r.div->end(); }
+    );
+
+    lua.new_usertype<lines_ref>("bclistlines",
+        sol::call_constructor, sol::no_constructor,
+        "size", [](const lines_ref &t) { return t.list->lines.size(); },
+        "text", [](const lines_ref &t, std::size_t i) { return t.list->text(i - 1); },
+        "key", [](const lines_ref &t, std::size_t i) { return t.list->symbols.name(t.list->lines.keys[i - 1]); },
+        "key_id", [](const lines_ref &t, std::size_t i) { return t.list->lines.keys[i - 1]; },
+        "from", [](const lines_ref &t, std::size_t i) { return t.list->lines.from[i - 1]; },
+        "to", [](const lines_ref &t, std::size_t i) { return t.list->lines.to[i - 1]; },
+        "indent", [](const lines_ref &t, std::size_t i) { return t.list->lines.indent[i - 1]; },
+        "line_at", [](const lines_ref &t, std::size_t addr, sol::optional<bool> last) -> sol::optional<std::size_t> {
+            const std::size_t line = t.list->lines.line_at(addr, last.value_or(false));
+            if (line == bclist::max_line) {
+                return sol::nullopt;
+            }
+            return line + 1;
+        },
+        "span", [](const lines_ref &t, std::size_t i) { return t.list->lines.span(i - 1); },
+        "string", [](const lines_ref &t, sol::optional<bool> from) { return t.list->full(from.value_or(false)); }
     );
 
-    lua.new_usertype<bclist>("bclist",
+    lua.new_usertype<bclist::flow::block>("bclistblock",
         sol::call_constructor, sol::no_constructor,
-        "refs", [&lua](bclist &b) {
+        "first", sol::readonly(&bclist::flow::block::first),
+        "last", sol::readonly(&bclist::flow::block::last),
+        "successors", [](const bclist::flow::block &b) { return sol::as_table(b.successors); }
+    );
+
+    lua.new_usertype<bclist::flow>("bclistflow",
+        sol::call_constructor, sol::no_constructor,
+        "blocks", [](const bclist::flow &f) { return sol::as_table(f.blocks); },
+        "is_target", &bclist::flow::is_target,
+        "block", &bclist::flow::block_at,
+        "jumps_to", [](const bclist::flow &f, std::size_t ins) {
+            const auto from = f.jumps_to(ins);
+            return sol::as_table(std::vector<std::size_t>(from.begin(), from.end()));
+        }
+    );
+
+    lua.new_usertype<list_ref>("bclist",
+        sol::call_constructor, sol::no_constructor,
+        "refs", [&lua](const list_ref &r) {
+            const bclist &b      = *r.list;
+            sol::table    result = lua.create_table();
+            for (std::size_t i = 0; i < b.xrefs.size(); i++) {
+                sol::table uses = lua.create_table();
+                for (const auto &use: b.xrefs.at(i)) {
+                    uses.add(use.addr);
+                }
+                result[b.xrefs.defs[i]] = uses;
+            }
+            return result;
+        },
+        // uses of the definition: {addr = ..., line = ..., proto = ...}, lines and prototypes are numbered from 1
+        "xrefs", [&lua](const list_ref &r, std::size_t def) {
             sol::table result = lua.create_table();
-            for (const auto &[key, value]: b.refs) {
-                result[key] = sol::as_table(value);
+            for (const auto &use: r.list->xrefs.find(def)) {
+                result.add(lua.create_table_with("addr", use.addr, "line", use.line + 1, "proto", use.proto + 1));
             }
             return result;
         },
-        "divs", &bclist::divs,
-        "info", &bclist::info
+        "flows", [](const list_ref &r) { return sol::as_table(r.list->flows); },
+        "divs", sol::property([](const list_ref &r) { return div_ref{r.list, &r.list->divs, nullptr}; }),
+        "lines", [](const list_ref &r) { return lines_ref{r.list}; },
+        "text", [](const list_ref &r, std::size_t row) { return r.list->text(row - 1); },
+        // tokens of the row: {offset = ..., length = ..., type = ..., key = ..., key_id = ...}, offsets are byte columns from 1
+        "tokens", [&lua](const list_ref &r, std::size_t row) {
+            sol::table result = lua.create_table();
+            for (const auto &t: r.list->tokens(row - 1)) {
+                result.add(lua.create_table_with("offset", t.offset + 1, "length", t.length, "type", static_cast<int>(t.type), "key", r.list->symbols.name(t.key), "key_id", t.key));
+            }
+            return result;
+        },
+        "full", [](const list_ref &r) { return r.list->full(); },
+        "symbol", [](const list_ref &r, std::string_view name) { return r.list->symbols.find(name); },
+        "symbol_name", [](const list_ref &r, bclist::symbol id) { return r.list->symbols.name(id); },
+        "find_line", [](const list_ref &r, std::string_view name) -> sol::optional<std::size_t> {
+            const std::size_t line = r.list->find_line(name);
+            if (line == bclist::max_line) {
+                return sol::nullopt;
+            }
+            return line + 1;
+        },
+        "info", sol::property([](const list_ref &r) { return dump_info_ref{{r.list, r.list->info}}; })
     );
 
     lua.new_usertype<File>("File",
         sol::call_constructor, sol::no_constructor,
-        "path", [](File &f) { return f.path.toStdString(); },
-        "dump_info", [](File &f) { return f.dump_info.get(); },
-        "is_opened", [](File &f) { return f.is_opened(); }
+        "path", [](const File &f) { return f.path.toStdString(); },
+        "dump_info", [](const File &f) -> sol::optional<list_ref> {
+            if (!f.dump_info) {
+                return sol::nullopt;
+            }
+            return list_ref{f.dump_info};
+        },
+        "is_opened", [](const File &f) { return f.is_opened(); }
     );
 }
\ No newline at end of file
@@ -116,7 +116,8 @@ void LuaCustom::initialize(LuaPlugin &plugin) {
 
     // functions
     lua.set_function("print", [&plugin](const sol::variadic_args &args) { LuaCustom::print(plugin, args); });
-    lua.set_function("highlight", &LuaCustom::highlight);
+    lua.set_function("highlight", [&plugin](int from, int to, int color) { LuaCustom::highlight(plugin, from, to, color); });
+    lua.set_function("highlight_many", [&plugin](const sol::table &ranges, int color) { LuaCustom::highlight_many(plugin, ranges, color); });
 
     // types (separate functions to avoid large obj files)
     initialize_dislua_types(lua);
@@ -136,6 +137,21 @@ void LuaCustom::print(LuaPlugin &plugin, const sol::variadic_args &args) {
     plugin.message(result);
 }
 
-void LuaCustom::highlight(int from, int to, int color) {
-    MainWindow::instance()->highlight(from, to, color);
+void LuaCustom::highlight(const LuaPlugin &plugin, int from, int to, int color) {
+    // plugins run in their own threads
+    QMetaObject::invokeMethod(MainWindow::instance(), [from, to, color, generation = plugin.generation] {
+        MainWindow::instance()->highlight(from, to, color, generation);
+    }, Qt::QueuedConnection);
+}
+
+void LuaCustom::highlight_many(const LuaPlugin &plugin, const sol::table &ranges, int color) {
+    std::vector<std::pair<std::size_t, std::size_t>> result;
+    result.reserve(ranges.size());
+    for (std::size_t i = 1; i <= ranges.size(); i++) {
+        const sol::table range = ranges[i];
+        result.emplace_back(range.get<std::size_t>(1), range.get<std::size_t>(2));
+    }
+    QMetaObject::invokeMethod(MainWindow::instance(), [result = std::move(result), color, generation = plugin.generation] {
+        MainWindow::instance()->highlight(result, color, generation);
+    }, Qt::QueuedConnection);
 }
\ No newline at end of file
@@ -22,13 +22,24 @@
 
 #include "plugins.hpp"
 
+// The dump of a list seen from lua, read only. It shares the list so it stays valid after the file is closed or reloaded.
+struct dump_info_ref {
+    std::shared_ptr<const dislua::dump_info> info;
+};
+
+// A prototype of the dump, shares the list like dump_info_ref.
+struct proto_ref {
+    std::shared_ptr<const dislua::proto> proto;
+};
+
 namespace LuaCustom {
 void initialize_dislua_types(sol::state &lua);
 void initialize_bclist_types(sol::state &lua);
 void initialize(LuaPlugin &plugin);
 
 void print(LuaPlugin &plugin, const sol::variadic_args &args);
-void highlight(int from, int to, int color);
+void highlight(const LuaPlugin &plugin, int from, int to, int color);
+void highlight_many(const LuaPlugin &plugin, const sol::table &ranges, int color); // ranges = {{from, to}, ...}
 // todo:
 // jump, highlight, addresses/lines/variables/bytes
 // on open file events
@@ -38,11 +38,10 @@ sol::table convert_table(sol::state_view &lua, const dislua::table_t &table) {
     return result;
 }
 
-// for lua
+// for lua, refers to the constant of the prototype
 class kgc_variant {
 public:
-    template<typename T>
-    kgc_variant(T&& t): variant_{std::forward<T>(t)} {}
+    kgc_variant(std::shared_ptr<const dislua::kgc_t> v): variant_{std::move(v)} {}
 
     sol::object value(sol::state_view &lua) const {
         return std::visit(dislua::detail::overloaded{
@@ -52,7 +51,7 @@ public:
             [&lua](unsigned long long v)       -> sol::object { return sol::make_object(lua, v); },
             [&lua](std::complex<double> v)     -> sol::object { return sol::make_object(lua, v); },
             [&lua](const std::string &str)     -> sol::object { return sol::make_object(lua, str); }
-        }, variant_);
+        }, *variant_);
     }
 
     std::string type() const {
@@ -63,67 +62,123 @@ public:
             [](unsigned long long v)       -> std::string { return "ull"; },
             [](std::complex<double> v)     -> std::string { return "complex"; },
             [](const std::string &str)     -> std::string { return "string"; }
-        }, variant_);
+        }, *variant_);
     }
 
 private:
-    dislua::kgc_t variant_;
+    std::shared_ptr<const dislua::kgc_t> variant_; // shares the list of the file
 };
 
+// Vector of the dump seen from lua without copying it: view[i] (from 1), #view and pairs(view).
+// It shares the list of the file, so it stays valid after the file is closed or reloaded.
+template <typename T>
+struct vector_view {
+    std::shared_ptr<const std::vector<T>> items;
+};
+
+template <typename T, typename Owner>
+vector_view<T> view_of(const std::shared_ptr<Owner> &owner, const std::vector<T> &items) {
+    return {std::shared_ptr<const std::vector<T>>{owner, &items}};
+}
+
+// Items are read only: prototypes and constants refer to the dump, the others are copied.
+template <typename T>
+sol::object view_item(sol::state_view lua, const vector_view<T> &v, std::size_t i) {
+    return sol::make_object(lua, (*v.items)[i]);
+}
+
+template <>
+sol::object view_item(sol::state_view lua, const vector_view<dislua::kgc_t> &v, std::size_t i) {
+    return sol::make_object(lua, kgc_variant{{v.items, &(*v.items)[i]}});
+}
+
+template <>
+sol::object view_item(sol::state_view lua, const vector_view<dislua::proto> &v, std::size_t i) {
+    return sol::make_object(lua, proto_ref{{v.items, &(*v.items)[i]}});
+}
+
+template <typename T>
+void new_view_type(sol::state &lua, const std::string &name) {
+    using view = vector_view<T>;
+    lua.new_usertype<view>(name,
+        sol::call_constructor, sol::no_constructor,
+        sol::meta_function::length, [](const view &v) { return v.items->size(); },
+        sol::meta_function::index, [](sol::this_state s, const view &v, long long i) -> sol::object {
+            if (i < 1 || static_cast<std::size_t>(i) > v.items->size()) {
+                return sol::lua_nil;
+            }
+            return view_item(s, v, static_cast<std::size_t>(i - 1));
+        },
+        sol::meta_function::pairs, [](const view &v) {
+            auto next = [](sol::this_state s, const view &v, long long i) -> std::tuple<sol::object, sol::object> {
+                if (i < 0 || static_cast<std::size_t>(i) >= v.items->size()) {
+                    return {sol::lua_nil, sol::lua_nil};
+                }
+                return {sol::make_object(s, i + 1), view_item(s, v, static_cast<std::size_t>(i))};
+            };
+            return std::make_tuple(next, v, 0LL);
+        }
+    );
+}
+
 void LuaCustom::initialize_dislua_types(sol::state &lua) {
     lua.new_usertype<dislua::varname>("varname",
         sol::call_constructor, sol::no_constructor,
-        "type", &dislua::varname::type,
-        "name", &dislua::varname::name,
-        "start", &dislua::varname::start,
-        "end", &dislua::varname::end
+        "type", sol::readonly(&dislua::varname::type),
+        "name", sol::readonly(&dislua::varname::name),
+        "start", sol::readonly(&dislua::varname::start),
+        "end", sol::readonly(&dislua::varname::end)
     );
 
     lua.new_usertype<kgc_variant>("kgc",
         sol::call_constructor, sol::no_constructor,
-        "value", [&lua](kgc_variant &v) { return v.value(lua); },
+        "value", [&lua](const kgc_variant &v) { return v.value(lua); },
         "type", &kgc_variant::type
     );
 
+    new_view_type<decltype(dislua::proto::ins)::value_type>(lua, "instruction_view");
+    new_view_type<decltype(dislua::proto::uv)::value_type>(lua, "uv_view");
+    new_view_type<decltype(dislua::proto::kgc)::value_type>(lua, "kgc_view");
+    new_view_type<decltype(dislua::proto::knum)::value_type>(lua, "knum_view");
+    new_view_type<decltype(dislua::proto::lineinfo)::value_type>(lua, "lineinfo_view");
+    new_view_type<decltype(dislua::proto::uv_names)::value_type>(lua, "uv_name_view");
+    new_view_type<decltype(dislua::proto::varnames)::value_type>(lua, "varname_view");
+    new_view_type<decltype(dislua::dump_info::protos)::value_type>(lua, "proto_view");
+
     lua.new_usertype<dislua::instruction>("instruction",
         sol::call_constructor, sol::no_constructor,
-        "opcode", &dislua::instruction::opcode,
-        "a", &dislua::instruction::a,
-        "b", &dislua::instruction::b,
-        "c", &dislua::instruction::c,
-        "d", &dislua::instruction::d
+        "opcode", sol::readonly(&dislua::instruction::opcode),
+        "a", sol::readonly(&dislua::instruction::a),
+        "b", sol::readonly(&dislua::instruction::b),
+        "c", sol::readonly(&dislua::instruction::c),
+        "d", sol::readonly(&dislua::instruction::d)
     );
     
-    lua.new_usertype<dislua::proto>("proto",
+    lua.new_usertype<proto_ref>("proto",
         sol::call_constructor, sol::no_constructor,
-        "flags", &dislua::proto::flags,
-        "numparams", &dislua::proto::numparams,
-        "framesize", &dislua::proto::framesize,
-        "firstline", &dislua::proto::firstline,
-        "numline", &dislua::proto::numline,
-        "instructions", [](dislua::proto &p) { return sol::as_table(p.ins); },
-        "uv_values", [](dislua::proto &p) { return sol::as_table(p.uv); },
-        "kgc_values", [&lua](dislua::proto &p) {
-            sol::table result = lua.create_table();
-            for (int i = 0; i < p.kgc.size(); i++) {
-                result[i + 1] = kgc_variant{p.kgc[i]};
-            }
-            return result;
-        },
-        "knum_values", [](dislua::proto &p) { return sol::as_table(p.knum); },
-        "lineinfo", [](dislua::proto &p) { return sol::as_table(p.lineinfo); },
-        "uv_names", [](dislua::proto &p) { return sol::as_table(p.uv_names); },
-        "varnames", [](dislua::proto &p) { return sol::as_table(p.varnames); }
+        "flags", sol::property([](const proto_ref &r) { return r.proto->flags; }),
+        "numparams", sol::property([](const proto_ref &r) { return r.proto->numparams; }),
+        "framesize", sol::property([](const proto_ref &r) { return r.proto->framesize; }),
+        "firstline", sol::property([](const proto_ref &r) { return r.proto->firstline; }),
+        "numline", sol::property([](const proto_ref &r) { return r.proto->numline; }),
+        "instructions", [](const proto_ref &r) { return view_of(r.proto, r.proto->ins); },
+        "uv_values", [](const proto_ref &r) { return view_of(r.proto, r.proto->uv); },
+        "kgc_values", [](const proto_ref &r) { return view_of(r.proto, r.proto->kgc); },
+        "knum_values", [](const proto_ref &r) { return view_of(r.proto, r.proto->knum); },
+        "lineinfo", [](const proto_ref &r) { return view_of(r.proto, r.proto->lineinfo); },
+        "uv_names", [](const proto_ref &r) { return view_of(r.proto, r.proto->uv_names); },
+        "varnames", [](const proto_ref &r) { return view_of(r.proto, r.proto->varnames); }
     );
 
-    lua.new_usertype<dislua::dump_info>("dump_info",
+    lua.new_usertype<dump_info_ref>("dump_info",
         sol::call_constructor, sol::no_constructor,
-        "header_flags", [](dislua::dump_info &i) { return i.header.flags; },
-        "debug_name", [](dislua::dump_info &i) { return i.header.debug_name; },
-        "version", &dislua::dump_info::version,
-        "protos", [](dislua::dump_info &i) { return sol::as_table(i.protos); },
-        "buffer", &dislua::dump_info::buf,
+        "header_flags", [](const dump_info_ref &r) { return r.info->header.flags; },
+        "debug_name", [](const dump_info_ref &r) { return r.info->header.debug_name; },
+        "version", sol::property([](const dump_info_ref &r) { return r.info->version; }),
+        "protos", [](const dump_info_ref &r) { return view_of(r.info, r.info->protos); },
+        // a copy, the dump isn't changed from lua
+        "buffer", sol::property([](const dump_info_ref &r) { return r.info->buf; }),
 
-        "compiler", [](dislua::dump_info &i) { return i.compiler(); }
+        "compiler", [](const dump_info_ref &r) { return r.info->compiler(); }
     );
 }
\ No newline at end of file
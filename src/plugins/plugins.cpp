@@ -17,21 +17,35 @@
 
 #include "plugins.hpp"
 
-#include <fmt/chrono.h>
+#include <fmt/format.h>
 
 #include "../mainwindow.hpp"
 #include "customfuncs.hpp"
 
 namespace fs = std::filesystem;
 
-const std::unordered_map<LuaPluginManager::MessageType, std::string> message_type_strings = {
-    { LuaPluginManager::MessageType::Info, "(info)" },
-    { LuaPluginManager::MessageType::Script, "(script)" },
-    { LuaPluginManager::MessageType::Error, "(error)" }
-};
+namespace {
+// instructions between the checks of the cancel flag
+constexpr int cancel_check_count = 1000;
+
+thread_local const std::atomic_bool *current_cancel = nullptr;
+
+void cancel_hook(lua_State *L, lua_Debug *) {
+    if (current_cancel && *current_cancel) {
+        luaL_error(L, "the plugin was canceled");
+    }
+}
+
+QString plugin_name(const LuaPlugin &plugin) {
+    return QString::fromStdString(plugin.path.filename().string());
+}
+} // namespace
+
 
 LuaPlugin::~LuaPlugin() {
-    manager->message(LuaPluginManager::MessageType::Info, fmt::format("Unloading the plugin {}...", path.filename().string()));
+    stop();
+    const std::string name = path.filename().string();
+    manager->message(LuaPluginManager::MessageType::Info, fmt::format("Unloading the plugin {}...", name), name);
 }
 
 bool LuaPlugin::run() {
@@ -46,28 +60,98 @@ bool LuaPlugin::run() {
     return result;
 }
 
+void LuaPlugin::open_file(std::shared_ptr<const File> file) {
+    current_cancel = &canceled;
+    sol::protected_function        func   = state["on_open_file"];
+    sol::protected_function_result result = func(file.get());
+    if (!result.valid()) {
+        sol::error err = result;
+        failure        = err.what();
+    }
+    current_cancel = nullptr;
+}
+
+void LuaPlugin::stop() {
+    // a worker that has already returned is reported by the finished handler
+    if (!worker || worker->isFinished()) {
+        return;
+    }
+    canceled = true;
+    worker->wait();
+    worker = nullptr; // deleted by the finished handler
+    emit manager->statusChanged(plugin_name(*this), LuaPluginManager::Status::Canceled);
+}
+
 void LuaPlugin::message(std::string_view text) {
-    manager->message(LuaPluginManager::MessageType::Script, fmt::format("{}: {}", path.filename().string(), text));
+    manager->message(LuaPluginManager::MessageType::Script, text, path.filename().string());
 }
 
 void LuaPluginManager::openFile(std::weak_ptr<File> f) {
+    cancel();
     file = f;
 
-    for (auto &plugin: plugins) {
-        sol::protected_function func = plugin->state["on_open_file"];
-        sol::protected_function_result result = func(file.lock());
-        plugin->valid_result(result);
+    // the plugins read a file of their own sharing the list, closing or reloading the opened one doesn't change it
+    std::shared_ptr<const File> snapshot;
+    if (const auto opened = f.lock()) {
+        auto copy       = std::make_shared<File>();
+        copy->path      = opened->path;
+        copy->dump_info = opened->dump_info;
+        snapshot        = std::move(copy);
+    }
+    for (const auto &plugin: plugins) {
+        const sol::object handler = plugin->state["on_open_file"];
+        if (handler.get_type() == sol::type::function) {
+            start(plugin, snapshot);
+        }
+    }
+}
+
+void LuaPluginManager::start(const std::shared_ptr<LuaPlugin> &plugin, std::shared_ptr<const File> snapshot) {
+    plugin->canceled   = false;
+    plugin->generation = fileGeneration;
+    plugin->failure.clear();
+    lua_sethook(plugin->state.lua_state(), cancel_hook, LUA_MASKCOUNT, cancel_check_count);
+
+    QThread *worker = QThread::create([p = plugin.get(), snapshot] {
+        p->open_file(snapshot);
+    });
+    plugin->worker = worker;
+    connect(worker, &QThread::finished, this, [this, worker, weak = std::weak_ptr{plugin}] {
+        worker->deleteLater();
+        // the plugin could be stopped or unloaded meanwhile
+        if (const auto plugin = weak.lock(); plugin && plugin->worker == worker) {
+            plugin->worker = nullptr;
+            finish(*plugin);
+        }
+    });
+
+    emit statusChanged(plugin_name(*plugin), Status::Running);
+    worker->start();
+}
+
+void LuaPluginManager::finish(LuaPlugin &plugin) {
+    if (plugin.failure.empty()) {
+        emit statusChanged(plugin_name(plugin), Status::Finished);
+        return;
+    }
+    emit statusChanged(plugin_name(plugin), Status::Failed);
+    error(&plugin, plugin.failure);
+}
+
+void LuaPluginManager::cancel() {
+    fileGeneration++;
+    for (const auto &plugin: plugins) {
+        plugin->stop();
     }
 }
 
-void LuaPluginManager::message(MessageType type, std::string_view text) {
-    const std::string string_type = message_type_strings.at(type);
-    const auto now = std::chrono::system_clock::now();
-    emit onMessage(fmt::format("[{:%d.%m.%Y %H:%M:%S}] {:s} {:s}", now, string_type, text));
+void LuaPluginManager::message(MessageType type, std::string_view text, std::string_view plugin) {
+    emit onMessage(type, QString::fromUtf8(plugin.data(), static_cast<qsizetype>(plugin.size())), QString::fromUtf8(text.data(), static_cast<qsizetype>(text.size())), QDateTime::currentDateTime());
 }
 
 void LuaPluginManager::error(LuaPlugin *plugin, std::string_view reason) {
-    message(LuaPluginManager::MessageType::Error, fmt::format("Error running plugin {}: {}", plugin->path.filename().string(), reason));
+    const std::string name = plugin->path.filename().string();
+    message(LuaPluginManager::MessageType::Error, fmt::format("Error running plugin {}: {}", name, reason), name);
 
     plugins.remove_if([plugin](const std::shared_ptr<LuaPlugin> &p) {
         return p.get() == plugin;
@@ -78,7 +162,7 @@ bool LuaPluginManager::loadPlugin(std::filesystem::path path) {
     auto result  = std::make_shared<LuaPlugin>(this);
     result->path = path;
 
-    message(MessageType::Info, fmt::format("Loading plugin {}...", path.filename().string()));
+    message(MessageType::Info, fmt::format("Loading plugin {}...", path.filename().string()), path.filename().string());
 
     const std::string spath = path.string();
     LuaCustom::initialize(*result);
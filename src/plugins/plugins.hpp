@@ -19,7 +19,11 @@
 #define LUAD_PLUGINS_HPP
 
 #include <QObject>
+#include <QDateTime>
+#include <QThread>
 
+#include <atomic>
+#include <cstdint>
 #include <filesystem>
 #include <sol/sol.hpp>
 
@@ -35,10 +39,18 @@ struct LuaPlugin {
     std::filesystem::path path;
     sol::state            state;
 
+    // on_open_file runs in the worker, nothing else touches the state until it's finished
+    QThread         *worker = nullptr;
+    std::atomic_bool canceled{false};
+    std::string      failure;        // error of the last call in the worker
+    std::uint64_t    generation = 0; // of the file the worker runs for, see LuaPluginManager::generation()
+
     template <typename T>
     requires(std::is_base_of_v<sol::proxy_base<T>, T>) bool valid_result(const T &result);
 
     bool run();
+    void open_file(std::shared_ptr<const File> file);
+    void stop();
     void message(std::string_view text);
 };
 
@@ -53,23 +65,44 @@ public:
         Script,
         Error,
     };
-    void message(MessageType type, std::string_view text);
+    Q_ENUM(MessageType)
+    enum class Status {
+        Running,
+        Finished,
+        Canceled,
+        Failed,
+    };
+    Q_ENUM(Status)
+    void message(MessageType type, std::string_view text, std::string_view plugin = {});
     void error(LuaPlugin *plugin, std::string_view text);
 
     bool loadPlugin(std::filesystem::path path);
     void loadPlugins();
 
+    // Stop the running plugins and wait for them, their results would belong to the file being closed.
+    void cancel();
+    // Changed by cancel(), highlights queued by the plugins of an older file are dropped.
+    std::uint64_t generation() const {
+        return fileGeneration;
+    }
+
     static LuaPluginManager *instance();
 
 signals:
-    void onMessage(std::string_view text);
+    // can be emitted from the plugin threads
+    void onMessage(LuaPluginManager::MessageType type, const QString &plugin, const QString &text, const QDateTime &time);
+    void statusChanged(const QString &plugin, LuaPluginManager::Status status);
 
 public slots:
     void openFile(std::weak_ptr<File> file);
 
 private:
+    void start(const std::shared_ptr<LuaPlugin> &plugin, std::shared_ptr<const File> snapshot);
+    void finish(LuaPlugin &plugin);
+
     std::weak_ptr<File>                   file;
     std::list<std::shared_ptr<LuaPlugin>> plugins;
+    std::uint64_t                         fileGeneration = 0;
 };
 
 template <typename T>
@@ -31,6 +31,10 @@ public:
 
     static inline const QString windowSizeKey     = "window_size";
     static inline const QString windowPositionKey = "window_position";
+    static inline const QString lazyLinesKey      = "lazy_lines";
+    static inline const QString cacheEnabledKey   = "listing_cache";
+    static inline const QString cacheSizeKey      = "listing_cache_size"; // MiB
+    static inline const QString pluginLogSizeKey  = "plugin_log_size";    // messages
 
 private:
     Settings() = default;
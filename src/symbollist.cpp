@@ -0,0 +1,64 @@
+// Luad - Disassembler for compiled Lua scripts.
+// https://github.com/imring/Luad
+// Copyright (C) 2021-2023 Vitaliy Vorobets
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "symbollist.hpp"
+
+#include <QLineEdit>
+#include <QTableView>
+#include <QHeaderView>
+#include <QVBoxLayout>
+#include <QSortFilterProxyModel>
+
+#include "disassembler.hpp"
+
+SymbolList::SymbolList(Disassembler *disasm, QAbstractItemModel *model)
+    : QWidget{disasm}, disassembler{disasm}, filter{new QLineEdit{this}}, proxy{new QSortFilterProxyModel{this}}, view{new QTableView{this}} {
+    model->setParent(this);
+    proxy->setSourceModel(model);
+    proxy->setSortRole(Qt::UserRole);
+    proxy->setFilterKeyColumn(-1); // any column
+    proxy->setFilterCaseSensitivity(Qt::CaseInsensitive);
+
+    filter->setPlaceholderText("Filter");
+    filter->setClearButtonEnabled(true);
+
+    view->setModel(proxy);
+    view->verticalHeader()->hide();
+    view->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    view->setSortingEnabled(true);
+    view->sortByColumn(1, Qt::AscendingOrder);
+    // all rows have the same height, so the view doesn't measure them
+    view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+
+    QVBoxLayout *layout = new QVBoxLayout{this};
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(filter);
+    layout->addWidget(view);
+
+    connect(filter, &QLineEdit::textChanged, proxy, &QSortFilterProxyModel::setFilterFixedString);
+    connect(view, &QTableView::doubleClicked, this, &SymbolList::jump);
+}
+
+void SymbolList::jump(const QModelIndex &index) {
+    const QString name = index.siblingAtColumn(0).data().toString();
+    if (disassembler) {
+        disassembler->jump(name.toStdString());
+    }
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+// Luad - Disassembler for compiled Lua scripts.
+// https://github.com/imring/Luad
+// Copyright (C) 2021-2023 Vitaliy Vorobets
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef LUAD_SYMBOLLIST_HPP
+#define LUAD_SYMBOLLIST_HPP
+
+#include <QWidget>
+#include <QModelIndex>
+
+class QLineEdit;
+class QTableView;
+class QAbstractItemModel;
+class QSortFilterProxyModel;
+class Disassembler;
+
+// Table of named items with a filter, double click jumps to the name in column 0.
+// Models give Qt::UserRole data for sorting.
+class SymbolList : public QWidget {
+    Q_OBJECT
+
+public:
+    SymbolList(Disassembler *disasm, QAbstractItemModel *model);
+
+public slots:
+    void jump(const QModelIndex &index);
+
+protected:
+    Disassembler *disassembler;
+
+    QLineEdit             *filter;
+    QSortFilterProxyModel *proxy;
+    QTableView            *view;
+};
+
+#endif // LUAD_SYMBOLLIST_HPP
\ No newline at end of file
@@ -17,77 +17,114 @@
 
 #include "syntaxhighlighter.hpp"
 
-SyntaxHighlighter::SyntaxHighlighter(QTextDocument *parent) : QSyntaxHighlighter{parent} {
-    HighlightingRule rule;
+#include <algorithm>
 
-    keywordFormat.setForeground(Qt::darkBlue);
-    keywordFormat.setFontWeight(QFont::Bold);
-    const QString keywordPatterns[] = {QStringLiteral("\\bdo\\b"),    QStringLiteral("\\bend\\b"), QStringLiteral("\\btrue\\b"),
-                                       QStringLiteral("\\bfalse\\b"), QStringLiteral("\\bnil\\b"), QStringLiteral("\\binvalid\\b")};
-    for (const QString &pattern: keywordPatterns) {
-        rule.pattern = QRegularExpression(pattern);
-        rule.format  = keywordFormat;
-        highlightingRules.append(rule);
-    }
-
-    // dec numbers
-    numdecFormat.setForeground(Qt::darkGreen);
-    rule.pattern = QRegularExpression(QStringLiteral("\\b(\\+\\-){0,1}\\d+(\\.\\d+){0,1}\\b"));
-    rule.format  = numdecFormat;
-    highlightingRules.append(rule);
+namespace {
+bool isWordChar(QChar c) {
+    return c.isLetterOrNumber() || c == QLatin1Char('_');
+}
 
-    // bin numbers
-    numbinFormat.setForeground(Qt::darkGreen);
-    rule.pattern = QRegularExpression(QStringLiteral("\\b(\\+\\-){0,1}(0b)?[01]+\\b"));
-    rule.format  = numbinFormat;
-    highlightingRules.append(rule);
+bool isUpperWord(QStringView word) {
+    for (const QChar c: word) {
+        if (!c.isUpper() && !c.isDigit() && c != QLatin1Char('_')) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    // hex numbers
-    numhexFormat.setForeground(Qt::darkGreen);
-    rule.pattern = QRegularExpression(QStringLiteral("\\b(\\+\\-){0,1}(0x)?[0-9A-Fa-f]+\\b"));
-    rule.format  = numhexFormat;
-    highlightingRules.append(rule);
+// word starting with a letter or _
+bclist::token::kind wordKind(QStringView word) {
+    static const QStringView keywords[] = {u"do", u"end", u"nil", u"true", u"false", u"invalid"};
+    static const QStringView names[]    = {u"proto", u"uv_", u"kgc_", u"knum_"};
 
-    quotationFormat.setForeground(Qt::darkCyan);
-    rule.pattern = QRegularExpression(QStringLiteral("\".*\""));
-    rule.format  = quotationFormat;
-    highlightingRules.append(rule);
+    for (const QStringView keyword: keywords) {
+        if (word == keyword) {
+            return bclist::token::keyword;
+        }
+    }
+    if (word.startsWith(u"label_")) {
+        return bclist::token::label;
+    }
+    for (const QStringView name: names) {
+        if (word.size() > name.size() && word.startsWith(name) && word[name.size()].isDigit()) {
+            return bclist::token::name;
+        }
+    }
+    return isUpperWord(word) ? bclist::token::opcode : bclist::token::none;
+}
+} // namespace
 
-    singleLineCommentFormat.setForeground(Qt::gray);
-    rule.pattern = QRegularExpression(QStringLiteral("\\-\\-[^\n]*"));
-    rule.format  = singleLineCommentFormat;
-    highlightingRules.append(rule);
+SyntaxHighlighter::SyntaxHighlighter() {
+    formats[bclist::token::keyword].setForeground(Qt::darkBlue);
+    formats[bclist::token::keyword].setFontWeight(QFont::Bold);
+    formats[bclist::token::opcode].setFontWeight(QFont::Bold);
+    formats[bclist::token::label].setForeground(Qt::darkRed);
+    formats[bclist::token::name].setForeground(Qt::darkMagenta);
+    formats[bclist::token::number].setForeground(Qt::darkGreen);
+    formats[bclist::token::string].setForeground(Qt::darkCyan);
+    formats[bclist::token::comment].setForeground(Qt::gray);
+}
 
-    multiLineCommentFormat.setForeground(Qt::gray);
-    commentStartExpression = QRegularExpression(QStringLiteral("\\-\\-\\[\\["));
-    commentEndExpression   = QRegularExpression(QStringLiteral("\\]\\]"));
+QList<QTextLayout::FormatRange> SyntaxHighlighter::highlight(const QString &text) const {
+    return highlight(tokenize(text));
 }
 
-void SyntaxHighlighter::highlightBlock(const QString &text) {
-    for (const HighlightingRule &rule: qAsConst(highlightingRules)) {
-        QRegularExpressionMatchIterator matchIterator = rule.pattern.globalMatch(text);
-        while (matchIterator.hasNext()) {
-            QRegularExpressionMatch match = matchIterator.next();
-            setFormat(match.capturedStart(), match.capturedLength(), rule.format);
+QList<QTextLayout::FormatRange> SyntaxHighlighter::highlight(std::span<const bclist::token> tokens, qsizetype shift) const {
+    QList<QTextLayout::FormatRange> result;
+    result.reserve(static_cast<qsizetype>(tokens.size()));
+    for (const bclist::token &t: tokens) {
+        if (t.type != bclist::token::none && t.type < formats.size()) {
+            result.append({static_cast<int>(shift + t.offset), static_cast<int>(t.length), formats[t.type]});
         }
     }
-    setCurrentBlockState(0);
+    return result;
+}
+
+std::vector<bclist::token> SyntaxHighlighter::tokenize(QStringView text) {
+    std::vector<bclist::token> result;
+    const auto                 add = [&](bclist::token::kind type, qsizetype start, qsizetype end) {
+        if (type != bclist::token::none) {
+            result.push_back({static_cast<std::uint32_t>(start), static_cast<std::uint32_t>(end - start), type, bclist::symbol::none});
+        }
+    };
 
-    int startIndex = 0;
-    if (previousBlockState() != 1)
-        startIndex = text.indexOf(commentStartExpression);
+    const qsizetype size = text.size();
+    for (qsizetype i = 0; i < size;) {
+        const QChar     c     = text[i];
+        const qsizetype start = i;
 
-    while (startIndex >= 0) {
-        QRegularExpressionMatch match         = commentEndExpression.match(text, startIndex);
-        int                     endIndex      = match.capturedStart();
-        int                     commentLength = 0;
-        if (endIndex == -1) {
-            setCurrentBlockState(1);
-            commentLength = text.length() - startIndex;
+        if (c == QLatin1Char('-') && i + 1 < size && text[i + 1] == QLatin1Char('-')) {
+            add(bclist::token::comment, i, size);
+            break;
+        } else if (c == QLatin1Char('"')) {
+            for (++i; i < size && text[i] != QLatin1Char('"'); ++i) {
+                if (text[i] == QLatin1Char('\\')) {
+                    ++i;
+                }
+            }
+            i = std::min(i + 1, size);
+            add(bclist::token::string, start, i);
+        } else if (c.isDigit() || ((c == QLatin1Char('-') || c == QLatin1Char('+')) && i + 1 < size && text[i + 1].isDigit() && (i == 0 || !isWordChar(text[i - 1])))) {
+            // 12, -3, 2.500000, 1e+10, 0b0101, 0x1F, 0B (bytes of an instruction)
+            const qsizetype digits = c.isDigit() ? i : i + 1;
+            const bool      hex    = digits + 1 < size && text[digits] == QLatin1Char('0') && text[digits + 1].toLower() == QLatin1Char('x');
+            for (i = digits + 1; i < size; ++i) {
+                const QChar n        = text[i];
+                const bool  exponent = !hex && (n == QLatin1Char('+') || n == QLatin1Char('-')) && text[i - 1].toLower() == QLatin1Char('e');
+                if (!isWordChar(n) && n != QLatin1Char('.') && !exponent) {
+                    break;
+                }
+            }
+            add(bclist::token::number, start, i);
+        } else if (isWordChar(c)) {
+            while (i < size && isWordChar(text[i])) {
+                ++i;
+            }
+            add(wordKind(text.sliced(start, i - start)), start, i);
         } else {
-            commentLength = endIndex - startIndex + match.capturedLength();
+            ++i;
         }
-        setFormat(startIndex, commentLength, multiLineCommentFormat);
-        startIndex = text.indexOf(commentStartExpression, startIndex + commentLength);
     }
+    return result;
 }
\ No newline at end of file
@@ -18,36 +18,29 @@
 #ifndef LUAD_SYNTAXHIGHLIGHTER_HPP
 #define LUAD_SYNTAXHIGHLIGHTER_HPP
 
+#include <span>
+#include <array>
+#include <vector>
+
+#include <QTextLayout>
 #include <QTextCharFormat>
-#include <QRegularExpression>
-#include <QSyntaxHighlighter>
 
-class SyntaxHighlighter : public QSyntaxHighlighter {
-    Q_OBJECT
+#include "bclist.hpp"
 
+// Formats of a single line of the listing. Lines rendered by bclist come with tokens,
+// other lines are split into tokens with a single pass over the text.
+class SyntaxHighlighter {
 public:
-    SyntaxHighlighter(QTextDocument *parent = nullptr);
+    SyntaxHighlighter();
+
+    QList<QTextLayout::FormatRange> highlight(const QString &text) const;
+    // Tokens of a line starting at column `shift` of the laid out text.
+    QList<QTextLayout::FormatRange> highlight(std::span<const bclist::token> tokens, qsizetype shift = 0) const;
 
-protected:
-    void highlightBlock(const QString &text) override;
+    static std::vector<bclist::token> tokenize(QStringView text);
 
 private:
-    struct HighlightingRule {
-        QRegularExpression pattern;
-        QTextCharFormat    format;
-    };
-    QVector<HighlightingRule> highlightingRules;
-
-    QRegularExpression commentStartExpression;
-    QRegularExpression commentEndExpression;
-
-    QTextCharFormat keywordFormat;
-    QTextCharFormat singleLineCommentFormat;
-    QTextCharFormat multiLineCommentFormat;
-    QTextCharFormat quotationFormat;
-    QTextCharFormat numdecFormat;
-    QTextCharFormat numbinFormat;
-    QTextCharFormat numhexFormat;
+    std::array<QTextCharFormat, bclist::token::comment + 1> formats;
 };
 
 #endif // LUAD_SYNTAXHIGHLIGHTER_HPP
\ No newline at end of file
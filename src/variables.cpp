@@ -15,84 +15,75 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#include "variables.hpp"
-
-#include <QHeaderView>
-
-#include "disassembler.hpp"
-
-Variables::Variables(Disassembler *disasm, std::weak_ptr<File> file) : QTableWidget{disasm}, disassembler{disasm}, file{file} {
-    verticalHeader()->hide();
-    horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
-    setSelectionBehavior(QAbstractItemView::SelectRows);
 
-    setColumnCount(4);
-    QStringList header;
-    header << "Name"
-           << "Start"
-           << "End"
-           //    << "Type"
-           << "Located in";
-    setHorizontalHeaderLabels(header);
+#include "variables.hpp"
 
+VariablesModel::VariablesModel(std::weak_ptr<File> file) : file{file} {
     update();
-
-    connect(this, &QTableWidget::cellDoubleClicked, this, &Variables::jump);
 }
 
-void Variables::update() {
-    clearContents();
-
-    auto ptr = file.lock();
-    if (!ptr || !ptr->is_opened()) {
-        return;
+void VariablesModel::update() {
+    beginResetModel();
+    variables.clear();
+
+    if (auto ptr = file.lock(); ptr && ptr->is_opened()) {
+        const auto &divs = ptr->dump_info->divs;
+        for (std::size_t i = 2; i < divs.additional.size(); i++) { // "i = 2" to exclude compiler & header info
+            const bclist::div &div = divs.additional[i];
+            for (const bclist::div &d: div.additional) {
+                for (const auto &val: d.lines) {
+                    if (val.key != bclist::symbol::none) {
+                        variables.push_back({val.key, div.key, val.from, val.to});
+                    }
+                }
+            }
+        }
     }
+    endResetModel();
+}
 
-    const auto &divs = ptr->dump_info->divs;
-    int         rows = 0;
-    setRowCount(rows);
-    for (int i = 2; i < divs.additional.size(); i++) { // "i = 2" to exclude compiler & header info
-        const bclist::div &div = divs.additional[i];
-
-        int prev = -1;
-        for (int l = 0; l < div.additional.size(); l++) {
-            const bclist::div &d = div.additional[l];
-            for (int k = 0; k < d.lines.size(); k++) {
-                setRowCount(rows + 1);
-                const auto &val = d.lines[k];
-                if (val.key.empty())
-                    continue;
-
-                QTableWidgetItem *name = new QTableWidgetItem{QString::fromStdString(val.key)};
-                name->setFlags(name->flags() & ~Qt::ItemIsEditable);
-                setItem(rows, 0, name);
-
-                QTableWidgetItem *start = new QTableWidgetItem{QStringLiteral("%1").arg(val.from, 8, 16, QLatin1Char('0'))};
-                start->setFlags(start->flags() & ~Qt::ItemIsEditable);
-                setItem(rows, 1, start);
-
-                QTableWidgetItem *end = new QTableWidgetItem{QStringLiteral("%1").arg(val.to, 8, 16, QLatin1Char('0'))};
-                end->setFlags(end->flags() & ~Qt::ItemIsEditable);
-                setItem(rows, 2, end);
+int VariablesModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(variables.size());
+}
 
-                // QTableWidgetItem *type = new QTableWidgetItem{QStringLiteral("%1").arg(val.to, 8, 16, QLatin1Char('0'))};
-                // type->setFlags(type->flags() & ~Qt::ItemIsEditable);
-                // setItem(rows, 3, type);
+int VariablesModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : 4;
+}
 
-                QTableWidgetItem *located = new QTableWidgetItem{QString::fromStdString(div.key)};
-                located->setFlags(located->flags() & ~Qt::ItemIsEditable);
-                setItem(rows, 3, located);
+QVariant VariablesModel::data(const QModelIndex &index, int role) const {
+    auto ptr = file.lock();
+    if (!ptr || !ptr->is_opened() || !index.isValid() || index.row() >= variables.size() || (role != Qt::DisplayRole && role != Qt::UserRole)) {
+        return {};
+    }
 
-                rows++;
-            }
-        }
+    const Variable &var = variables[index.row()];
+    switch (index.column()) {
+    case 0:
+    case 3: {
+        const std::string_view key = ptr->dump_info->symbols.name(index.column() == 0 ? var.key : var.proto);
+        return QString::fromUtf8(key.data(), key.size());
+    }
+    case 1:
+        return role == Qt::UserRole ? QVariant::fromValue(var.from) : QStringLiteral("%1").arg(var.from, 8, 16, QLatin1Char('0'));
+    case 2:
+        return role == Qt::UserRole ? QVariant::fromValue(var.to) : QStringLiteral("%1").arg(var.to, 8, 16, QLatin1Char('0'));
+    default:
+        return {};
     }
 }
 
-void Variables::jump(int row) {
-    const QTableWidgetItem *name    = item(row, 0);
-    const QString           namestr = name->data(0).toString();
-    if (disassembler) {
-        disassembler->jump(namestr.toStdString());
+QVariant VariablesModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return {};
     }
+    static const QStringList header = {"Name", "Start", "End", "Located in"};
+    return header.value(section);
+}
+
+Variables::Variables(Disassembler *disasm, std::weak_ptr<File> file) : Variables{disasm, new VariablesModel{file}} {}
+
+Variables::Variables(Disassembler *disasm, VariablesModel *model) : SymbolList{disasm, model}, model{model} {}
+
+void Variables::update() {
+    model->update();
 }
\ No newline at end of file
@@ -15,16 +15,40 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+
 #ifndef LUAD_VARIABLES_HPP
 #define LUAD_VARIABLES_HPP
 
-#include <QTableWidget>
+#include <QAbstractTableModel>
 
 #include "file.hpp"
+#include "symbollist.hpp"
+
+// Named lines (upvalues and constants) of the prototypes.
+class VariablesModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    VariablesModel(std::weak_ptr<File> file);
+
+    void update();
 
-class Disassembler;
+    int      rowCount(const QModelIndex &parent = {}) const override;
+    int      columnCount(const QModelIndex &parent = {}) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
 
-class Variables : public QTableWidget {
+private:
+    struct Variable {
+        bclist::symbol key, proto;
+        std::size_t    from, to;
+    };
+
+    std::weak_ptr<File>   file;
+    std::vector<Variable> variables;
+};
+
+class Variables : public SymbolList {
     Q_OBJECT
 
 public:
@@ -32,12 +56,10 @@ public:
 
     void update();
 
-public slots:
-    void jump(int row);
-
 private:
-    Disassembler       *disassembler;
-    std::weak_ptr<File> file;
+    Variables(Disassembler *disasm, VariablesModel *model);
+
+    VariablesModel *model;
 };
 
 #endif // LUAD_VARIABLES_HPP
\ No newline at end of file
@@ -19,7 +19,6 @@
 
 #include <QHeaderView>
 
-#include "utils.hpp"
 #include "disassembler.hpp"
 
 XrefMenu::XrefMenu(Disassembler *disasm, std::weak_ptr<File> file, std::size_t ref) : QTableWidget{disasm}, disassembler{disasm}, file{file} {
@@ -46,49 +45,31 @@ void XrefMenu::update(std::size_t ref) {
         return;
     }
 
-    const auto it = ptr->dump_info->refs.find(ref);
-    if (it == ptr->dump_info->refs.end()) {
-        return;
-    }
-
-    int i = 0;
-
-    const std::function<void(const bclist::div &divs)> findRefInDiv = [&](const bclist::div &divs) {
-        while (true) {
-            if (i == it->second.size()) {
-                return;
-            }
-
-            const std::size_t idx = utils::line_by_addr(divs.lines, it->second[i], true);
-            if (idx == bclist::max_line) {
-                break;
-            }
-
-            QTableWidgetItem *addr = new QTableWidgetItem{QStringLiteral("%1").arg(it->second[i], 8, 16, QLatin1Char('0'))};
-            addr->setFlags(addr->flags() & ~Qt::ItemIsEditable);
-            setItem(i, 0, addr);
-
-            QTableWidgetItem *li = new QTableWidgetItem{QString::fromStdString(divs.lines[idx].text)};
-            li->setFlags(li->flags() & ~Qt::ItemIsEditable);
-            setItem(i, 1, li);
-
-            i++;
+    // uses already have their lines
+    const auto uses = ptr->dump_info->xrefs.find(ref);
+    setRowCount(static_cast<int>(uses.size()));
+    for (int i = 0; i < uses.size(); i++) {
+        const bclist::xref_table::use &use = uses[i];
+        if (use.line == bclist::max_line) {
+            continue;
         }
 
-        for (const auto &add: divs.additional) {
-            findRefInDiv(add);
-        }
-    };
+        QTableWidgetItem *addr = new QTableWidgetItem{QStringLiteral("%1").arg(use.addr, 8, 16, QLatin1Char('0'))};
+        addr->setFlags(addr->flags() & ~Qt::ItemIsEditable);
+        setItem(i, 0, addr);
 
-    const auto &divs = ptr->dump_info->divs;
-    setRowCount(it->second.size());
-    for (int i = 2; i < divs.additional.size(); i++) { // "i = 2" to exclude compiler & header info
-        findRefInDiv(divs.additional[i]);
+        QTableWidgetItem *li = new QTableWidgetItem{QString::fromStdString(ptr->dump_info->text(use.line))};
+        li->setFlags(li->flags() & ~Qt::ItemIsEditable);
+        setItem(i, 1, li);
     }
 }
 
 void XrefMenu::jump(int row) {
-    const QString addrstr = item(row, 0)->data(0).toString();
+    const QTableWidgetItem *address = item(row, 0);
+    if (!address) {
+        return;
+    }
+    const QString addrstr = address->data(0).toString();
     const int     addr    = addrstr.toInt(nullptr, 16);
 
     if (disassembler) {